@@ -0,0 +1,212 @@
+// blockcache.cc
+//	Routines to manage a cache of disk sectors.
+//
+//	See blockcache.h for how blocks are found and replaced.
+
+#include "copyright.h"
+#include "debug.h"
+#include "blockcache.h"
+#include <algorithm>
+
+// Helpers for the hash table: blocks are keyed by their sector number.
+
+static int
+BlockSector(CachedBlock *block)
+{
+    return block->sector;
+}
+
+static unsigned
+HashSector(int sector)
+{
+    return (unsigned)sector;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::BlockCache
+// 	Initialize an empty block cache.
+//
+//	"numBlocks" is the number of sectors the cache can hold
+//----------------------------------------------------------------------
+
+BlockCache::BlockCache(int numBlocks)
+{
+    ASSERT(numBlocks > 0);
+    this->numBlocks = numBlocks;
+    blocks = new CachedBlock[numBlocks];
+    for (int i = 0; i < numBlocks; i++)
+    {
+        blocks[i].sector = -1;
+        blocks[i].referenced = FALSE;
+        blocks[i].pinCount = 0;
+        blocks[i].dirty = FALSE;
+        blocks[i].readAhead = FALSE;
+        blocks[i].filling = FALSE;
+        blocks[i].stale = FALSE;
+    }
+    hand = 0;
+    numDirty = 0;
+    bySector = new HashTable<int, CachedBlock *>(BlockSector, HashSector);
+}
+
+//----------------------------------------------------------------------
+// BlockCache::~BlockCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+BlockCache::~BlockCache()
+{
+    for (int i = 0; i < numBlocks; i++)
+        if (blocks[i].sector != -1)
+            bySector->Remove(blocks[i].sector);
+    delete bySector;
+    delete[] blocks;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Find
+// 	Return the block holding "sector", and note that it was used; or
+//	return NULL if the sector is not in the cache.
+//
+//	"sector" is the disk sector wanted
+//----------------------------------------------------------------------
+
+CachedBlock *
+BlockCache::Find(int sector)
+{
+    CachedBlock *block;
+
+    if (!bySector->Find(sector, &block))
+        return NULL;
+    block->referenced = TRUE;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Allocate
+// 	Find a block to hold "sector", which must not already be cached,
+//	replacing whatever the CLOCK hand picks.  The caller fills in the
+//	data.  Return NULL if every block is pinned or dirty.
+//
+//	"sector" is the disk sector that the block will hold
+//----------------------------------------------------------------------
+
+CachedBlock *
+BlockCache::Allocate(int sector)
+{
+    ASSERT(!bySector->IsInTable(sector));
+
+    // two sweeps are enough: the first clears every reference bit
+    for (int scanned = 0; scanned < 2 * numBlocks; scanned++)
+    {
+        CachedBlock *block = &blocks[hand];
+
+        hand = (hand + 1) % numBlocks;
+        if (block->pinCount > 0 || block->dirty)
+            continue;
+        if (block->sector != -1 && block->referenced)
+        {
+            block->referenced = FALSE; // second chance
+            continue;
+        }
+
+        if (block->sector != -1)
+        {
+            DEBUG(dbgDisk, "Block cache replacing sector " << block->sector);
+            bySector->Remove(block->sector);
+        }
+        block->sector = sector;
+        block->referenced = TRUE;
+        block->readAhead = FALSE;
+        block->filling = FALSE;
+        block->stale = FALSE;
+        bySector->Insert(block);
+        return block;
+    }
+    return NULL; // everything is pinned or dirty
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Invalidate
+// 	Drop a block from the cache, so that its sector will be read from
+//	disk next time.
+//----------------------------------------------------------------------
+
+void
+BlockCache::Invalidate(CachedBlock *block)
+{
+    ASSERT(block->pinCount == 0 && !block->dirty);
+    if (block->sector != -1)
+        bySector->Remove(block->sector);
+    block->sector = -1;
+    block->referenced = FALSE;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::Pin/Unpin
+// 	Keep a block in the cache, for instance while a disk transfer to
+//	or from it is in progress.  Pins nest.
+//----------------------------------------------------------------------
+
+void
+BlockCache::Pin(CachedBlock *block)
+{
+    block->pinCount++;
+}
+
+void
+BlockCache::Unpin(CachedBlock *block)
+{
+    ASSERT(block->pinCount > 0);
+    block->pinCount--;
+}
+
+//----------------------------------------------------------------------
+// BlockCache::MarkDirty/MarkClean
+// 	Note that a block holds data not yet on disk, or that it has now
+//	been written.  A dirty block is never replaced.
+//----------------------------------------------------------------------
+
+void
+BlockCache::MarkDirty(CachedBlock *block)
+{
+    if (!block->dirty)
+    {
+        block->dirty = TRUE;
+        numDirty++;
+    }
+}
+
+void
+BlockCache::MarkClean(CachedBlock *block)
+{
+    if (block->dirty)
+    {
+        block->dirty = FALSE;
+        numDirty--;
+    }
+}
+
+//----------------------------------------------------------------------
+// BlockCache::DirtyBlocks
+// 	Return every dirty block, sorted by sector number so that
+//	neighbouring sectors can be written together.
+//----------------------------------------------------------------------
+
+static bool
+SectorBefore(CachedBlock *a, CachedBlock *b)
+{
+    return a->sector < b->sector;
+}
+
+vector<CachedBlock *>
+BlockCache::DirtyBlocks()
+{
+    vector<CachedBlock *> dirty;
+
+    for (int i = 0; i < numBlocks && (int)dirty.size() < numDirty; i++)
+        if (blocks[i].dirty)
+            dirty.push_back(&blocks[i]);
+    sort(dirty.begin(), dirty.end(), SectorBefore);
+    return dirty;
+}
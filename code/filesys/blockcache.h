@@ -0,0 +1,73 @@
+// blockcache.h
+//	Data structures for caching disk sectors in memory.
+//
+//	The block cache holds a fixed number of sectors, found by sector
+//	number through a hash table.  When a sector has to be brought in
+//	and the cache is full, a victim is chosen with the CLOCK algorithm:
+//	a hand sweeps round the blocks, giving each recently used block a
+//	second chance, and taking the first one that has not been used
+//	since the hand last passed it.  Pinned blocks are never taken, and
+//	neither are dirty ones: those must be written back first.
+//
+//	The cache itself does no I/O; SynchDisk decides what goes in it.
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "hash.h"
+#include "callback.h"
+#include <vector>
+
+#define DefaultBlockCacheSize 256 // sectors cached unless -bc says otherwise
+
+// One cached sector.
+
+class CachedBlock
+{
+public:
+    int sector;            // which sector this is, or -1 if unused
+    bool referenced;       // used since the clock hand last passed?
+    int pinCount;          // while non-zero, the block stays put
+    bool dirty;            // changed since it was last written to disk
+    bool readAhead;        // read ahead, and not yet asked for
+    bool filling;          // being read into from disk
+    bool stale;            // written while filling: drop it once filled
+    vector<CallBackObj *> waiters; // told when filling is done
+    char data[SectorSize]; // contents of the sector
+};
+
+// The following class defines the block cache.
+
+class BlockCache
+{
+public:
+    BlockCache(int numBlocks); // Create an empty cache of "numBlocks" sectors
+    ~BlockCache();
+
+    CachedBlock *Find(int sector);     // Return the cached copy of "sector",
+                                       //  or NULL if it is not cached
+    CachedBlock *Allocate(int sector); // Make room for "sector", and return
+                                       //  its (not yet filled in) block; NULL
+                                       //  if every block is pinned
+    void Invalidate(CachedBlock *block); // Forget the contents of a block
+
+    void Pin(CachedBlock *block);   // Keep a block from being replaced
+    void Unpin(CachedBlock *block); //  until it is unpinned again
+
+    void MarkDirty(CachedBlock *block); // Note a block is newer than disk
+    void MarkClean(CachedBlock *block); // Note a block has been written
+    int NumDirty() { return numDirty; }
+    vector<CachedBlock *> DirtyBlocks(); // Every dirty block, in order
+                                         //  of sector number
+
+private:
+    CachedBlock *blocks;                      // the cached sectors
+    int numBlocks;                            // how many of them there are
+    int hand;                                 // the CLOCK hand
+    int numDirty;                             // how many blocks are dirty
+    HashTable<int, CachedBlock *> *bySector; // sector number -> block
+};
+
+#endif // BLOCKCACHE_H
@@ -0,0 +1,135 @@
+// dentrycache.cc
+//	Routines to remember what names in directories refer to.
+//
+//	The entries are kept on a list, most recently used first, with a
+//	map from (directory, name) to their place on it; the map is ordered
+//	by directory first, so the names of one directory sit together in
+//	it.
+
+#include "copyright.h"
+#include "debug.h"
+#include "dentrycache.h"
+#include "directory.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty dentry cache.
+//
+//	"size" is the number of lookups we remember
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache(int size)
+{
+    ASSERT(size > 0);
+    this->size = size;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	Forget everything.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+}
+
+//----------------------------------------------------------------------
+// DentryCache::MakeKey
+// 	Return the key for "name" in directory "parent".  Directories keep
+//	at most the first FileNameMaxLen characters of a name, so only
+//	those count here either; the file system does not cache a longer
+//	name for a directory that keeps fewer.
+//----------------------------------------------------------------------
+
+DentryCache::Key DentryCache::MakeKey(int parent, char *name)
+{
+    return Key(parent, string(name, strnlen(name, FileNameMaxLen)));
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	Return TRUE if we know what "name" in directory "parent" refers
+//	to, and if so, set "sector" to the sector of its header, or -1 if
+//	the directory has no such name, and "type" to its type.
+//
+//	"parent" is the header sector of the directory
+//	"name" is the name to look up in it
+//	"sector", "type" -- where to return what it names; "type" may be
+//	    NULL
+//----------------------------------------------------------------------
+
+bool DentryCache::Lookup(int parent, char *name, int *sector, int *type)
+{
+    map<Key, list<CachedDentry>::iterator>::iterator it;
+
+    it = index.find(MakeKey(parent, name));
+    if (it == index.end())
+    {
+        kernel->stats->numDentryMisses++;
+        return FALSE;
+    }
+    kernel->stats->numDentryHits++;
+    entries.splice(entries.begin(), entries, it->second);
+    *sector = it->second->sector;
+    if (type != NULL)
+        *type = it->second->type;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	Record what "name" in directory "parent" refers to, replacing
+//	whatever we knew about it, and drop the least recently used entry
+//	if there are too many.
+//
+//	"parent" is the header sector of the directory
+//	"name" is the name in it
+//	"sector" is the sector of the header it names, or -1 if none
+//	"type" is FILE_TYPE or DIRECTORY_TYPE
+//----------------------------------------------------------------------
+
+void DentryCache::Enter(int parent, char *name, int sector, int type)
+{
+    Key key = MakeKey(parent, name);
+    map<Key, list<CachedDentry>::iterator>::iterator it = index.find(key);
+    CachedDentry entry;
+
+    if (it != index.end())
+    {
+        entries.splice(entries.begin(), entries, it->second);
+        it->second->sector = sector;
+        it->second->type = type;
+        return;
+    }
+    entry.parent = parent;
+    entry.name = key.second;
+    entry.sector = sector;
+    entry.type = type;
+    entries.push_front(entry);
+    index[key] = entries.begin();
+
+    if ((int)entries.size() > size)
+    {
+        index.erase(Key(entries.back().parent, entries.back().name));
+        entries.pop_back();
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::ForgetDirectory
+// 	Drop every name cached for directory "parent", which has been
+//	removed; its header sector may be reused by something else.
+//----------------------------------------------------------------------
+
+void DentryCache::ForgetDirectory(int parent)
+{
+    map<Key, list<CachedDentry>::iterator>::iterator it;
+
+    it = index.lower_bound(Key(parent, string()));
+    while (it != index.end() && it->first.first == parent)
+    {
+        entries.erase(it->second);
+        index.erase(it++);
+    }
+}
@@ -0,0 +1,71 @@
+// dentrycache.h
+//	Data structures for remembering the results of looking names up
+//	in directories.
+//
+//	The dentry cache maps a (directory, name) pair -- the directory
+//	given by the sector of its header -- to what the name refers to:
+//	the sector of its header, and whether it is a file or a directory.
+//	It also remembers names that were looked up and not found
+//	("negative" entries), so that creating a file does not read its
+//	directory just to find out that the name is free.  A path whose
+//	every component is cached is resolved without reading any
+//	directory at all.
+//
+//	The file system keeps the cache up to date: every operation that
+//	adds or removes a name records the change here.  When the cache
+//	holds more than its size of entries, the least recently used ones
+//	are dropped.
+
+#ifndef DENTRYCACHE_H
+#define DENTRYCACHE_H
+
+#include "copyright.h"
+#include "sysdep.h"
+#include <list>
+#include <map>
+#include <string>
+
+#define DentryCacheSize 1024 // (directory, name) pairs remembered
+
+// One cached lookup.
+
+class CachedDentry
+{
+public:
+    int parent;  // header sector of the directory
+    string name; // the name looked up in it
+    int sector;  // header sector of what it names, or -1 if
+                 //  the directory has no such name
+    int type;    // FILE_TYPE or DIRECTORY_TYPE, if found
+};
+
+// The following class defines the dentry cache.
+
+class DentryCache
+{
+public:
+    DentryCache(int size); // Remember up to "size" lookups
+    ~DentryCache();
+
+    bool Lookup(int parent, char *name, int *sector, int *type);
+    // Is "name" in directory "parent"
+    //  cached?  If so, return what it
+    //  names in "sector" (-1 if
+    //  nothing) and "type"
+    void Enter(int parent, char *name, int sector, int type);
+    // Record what "name" in "parent"
+    //  names; "sector" -1 if nothing
+    void ForgetDirectory(int parent); // Directory "parent" has been
+                                      //  removed; drop its names
+
+private:
+    typedef pair<int, string> Key;
+
+    list<CachedDentry> entries; // most recently used first
+    map<Key, list<CachedDentry>::iterator> index;
+    int size; // entries we may keep
+
+    Key MakeKey(int parent, char *name); // Key for "name" in "parent"
+};
+
+#endif // DENTRYCACHE_H
@@ -1,50 +1,143 @@
 // directory.cc
 //	Routines to manage a directory of file names.
 //
-//	The directory is a table of fixed length entries; each
-//	entry represents a single file, and contains the file name,
-//	and the location of the file header on disk.  The fixed size
-//	of each directory entry means that we have the restriction
-//	of a fixed maximum size for file names.
+//	A directory is a hash table of entries, kept a block at a time
+//	(see directory.h).  Each entry represents a single file, and
+//	contains the file name, and the location of the file header on
+//	disk.  Entries are packed, and only as long as their names.
 //
-//	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
-//	from disk, and to write back any modifications back to disk.
+//	Everything that depends on how entries are laid out in a block is
+//	in FindInBlock, PutInBlock, TakeFromBlock and BlockEntries.
 //
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
+//	The constructor initializes an empty directory; we use
+//	FetchFrom/WriteBack to fetch the contents of the directory from
+//	disk, and to write back any modifications back to disk.  Only
+//	the blocks of a directory that are needed are read in.
+//	Every change to an entry marks the sectors holding it dirty, and
+//	WriteBack writes back just those sectors, so adding a name to a
+//	directory typically writes its header and a sector or two of one
+//	bucket.
+//
+//	A directory grows as entries are added, but never shrinks.  A
+//	directory on a disk written before there were hashed directories
+//	is a table of fixed length entries; it is converted when it is
+//	fetched, and can then grow like any other.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
+#include "debug.h"
 #include "utility.h"
 #include "filehdr.h"
 #include "directory.h"
 #include "disk.h"
+#include <algorithm>
+
+//----------------------------------------------------------------------
+// HashName
+// 	Hash a file name (FNV-1a), looking only at the part of it that
+//	is kept in the directory.
+//----------------------------------------------------------------------
+
+static unsigned int
+HashName(char *name, int limit)
+{
+    unsigned int hash = 2166136261u;
+
+    for (int i = 0; i < limit && name[i] != '\0'; i++)
+        hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+    return hash;
+}
+
+// Orders entries by their numbers.
+
+static bool
+EarlierEntry(const ListedEntry &a, const ListedEntry &b)
+{
+    return a.order < b.order;
+}
+
+//----------------------------------------------------------------------
+// UnpackEntry
+// 	Copy out the packed entry at "at", and return how many bytes it
+//	takes up.
+//----------------------------------------------------------------------
+
+static int
+UnpackEntry(char *at, ListedEntry *entry)
+{
+    int length = (unsigned char) at[0];
+
+    entry->type = at[1];
+    memcpy(&entry->sector, at + 2, sizeof(int));
+    memcpy(&entry->order, at + 6, sizeof(int));
+    memcpy(entry->name, at + EntryHeaderSize, length);
+    entry->name[length] = '\0';
+    return EntryHeaderSize + length;
+}
+
+//----------------------------------------------------------------------
+// PackEntry
+// 	Store "entry" packed at "at", and return how many bytes it takes
+//	up.
+//----------------------------------------------------------------------
+
+static int
+PackEntry(char *at, ListedEntry *entry)
+{
+    int length = strlen(entry->name);
+
+    at[0] = (char) length;
+    at[1] = (char) entry->type;
+    memcpy(at + 2, &entry->sector, sizeof(int));
+    memcpy(at + 6, &entry->order, sizeof(int));
+    memcpy(at + EntryHeaderSize, entry->name, length);
+    return EntryHeaderSize + length;
+}
+
+// The first two words of a block: the next block in the chain, and
+// the bytes of entries in use.
+
+#define NextBlock(data) (((int *)(data))[0])
+#define BytesUsed(data) (((int *)(data))[1])
 
 //----------------------------------------------------------------------
 // Directory::Directory
 // 	Initialize a directory; initially, the directory is completely
-//	empty.  If the disk is being formatted, an empty directory
-//	is all we need, but otherwise, we need to call FetchFrom in order
-//	to initialize it from disk.
-//
-//	"size" is the number of entries in the directory
+//	empty, with a single bucket.  If the disk is being
+//	formatted, or a directory created, an empty directory is all we
+//	need, but otherwise, we need to call FetchFrom in order to
+//	initialize it from disk.
 //----------------------------------------------------------------------
 
-Directory::Directory(int size)
+Directory::Directory()
 {
-    table = new DirectoryEntry[size];
+    ASSERT(sizeof(DirectoryHeader) == SectorSize);
+    ASSERT(BlockHeaderSize + EntryHeaderSize + FileNameMaxLen
+           <= DirBlockSectors * SectorSize);
+
+    file = NULL;
+    MakeEmpty();
+}
 
+//----------------------------------------------------------------------
+// Directory::MakeEmpty
+// 	Set up an empty directory in memory, with a single bucket, and
+//	mark all of it dirty.
+//----------------------------------------------------------------------
+
+void Directory::MakeEmpty()
+{
     // MP4 mod tag
-    memset(table, 0, sizeof(DirectoryEntry) * size); // dummy operation to keep valgrind happy
+    memset(&header, 0, sizeof(DirectoryHeader)); // dummy operation to keep valgrind happy
 
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-        table[i].inUse = FALSE;
+    header.magic = DirectoryMagic;
+    header.segments[0] = 1;
+    header.numSectors = 1 + DirBlockSectors;
+    headerDirty = TRUE;
+    NewBlock(1);
 }
 
 //----------------------------------------------------------------------
@@ -54,47 +147,501 @@ Directory::Directory(int size)
 
 Directory::~Directory()
 {
-    delete[] table;
+    Clear();
+}
+
+//----------------------------------------------------------------------
+// Directory::Clear
+// 	Throw away whatever the directory holds in memory.
+//----------------------------------------------------------------------
+
+void Directory::Clear()
+{
+    map<int, char *>::iterator it;
+
+    for (it = blocks.begin(); it != blocks.end(); ++it)
+        delete[] it->second;
+    blocks.clear();
+    dirtySectors.clear();
+    headerDirty = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Directory::FetchFrom
-// 	Read the contents of the directory from disk.
+// 	Read the contents of the directory from disk.  That is just the
+//	header; blocks are read in as they are needed, from "file", which
+//	must stay open while the directory is in use.
+//
+//	A flat table of the original format is read in whole instead, and
+//	converted (see Convert).
 //
 //	"file" -- file containing the directory contents
 //----------------------------------------------------------------------
 
 void Directory::FetchFrom(OpenFile *file)
 {
+    DirectoryEntry *table;
+    int tableSize;
+
+    Clear();
+    this->file = file;
+    (void)file->ReadAt((char *)&header, sizeof(DirectoryHeader), 0);
+    if (header.magic == DirectoryMagic)
+        return;
+
+    tableSize = file->Length() / sizeof(DirectoryEntry);
+    table = new DirectoryEntry[tableSize];
     (void)file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    Convert(table, tableSize);
+    delete[] table;
+}
+
+//----------------------------------------------------------------------
+// Directory::Convert
+// 	Make this an empty hashed directory in memory, and add the entries
+//	in use of a flat table of the original format to it, each numbered
+//	by its slot, as List numbered it.  Every block, and the header, is
+//	left dirty, so that the next WriteBack replaces the table on disk.
+//
+//	"table", "tableSize" -- the table, and how many entries it has
+//----------------------------------------------------------------------
+
+void Directory::Convert(DirectoryEntry *table, int tableSize)
+{
+    ListedEntry entry;
+
+    MakeEmpty();
+    for (int i = 0; i < tableSize; i++)
+        if (table[i].inUse)
+        {
+            memset(&entry, 0, sizeof(ListedEntry));
+            entry.sector = table[i].sector;
+            entry.order = i;
+            entry.type = table[i].File_or_DIR;
+            strncpy(entry.name, table[i].name, OldFileNameMaxLen);
+            header.numEntries++;
+            header.nextOrder = i + 1;
+            if (Place(&entry))
+                Split();
+        }
 }
 
 //----------------------------------------------------------------------
 // Directory::WriteBack
-// 	Write any modifications to the directory back to disk
+// 	Write any modifications to the directory back to disk: only the
+//	sectors holding an entry that has changed since the directory was
+//	read in or last written back, each run of them in one block
+//	written together, and the header if it changed.
 //
 //	"file" -- file to contain the new directory contents
 //----------------------------------------------------------------------
 
 void Directory::WriteBack(OpenFile *file)
 {
-    (void)file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    set<int>::iterator it;
+    int start, block, count;
+
+    if (headerDirty)
+        (void)file->WriteAt((char *)&header, SectorSize, 0);
+    it = dirtySectors.begin();
+    while (it != dirtySectors.end())
+    {
+        start = *it;
+        block = (--blocks.upper_bound(start))->first;
+        for (count = 1, ++it; it != dirtySectors.end() && *it == start + count
+                              && *it < block + DirBlockSectors; ++it)
+            count++;
+        (void)file->WriteAt(blocks[block] + (start - block) * SectorSize,
+                            count * SectorSize, start * SectorSize);
+    }
+    headerDirty = FALSE;
+    dirtySectors.clear();
+    this->file = file;
 }
 
 //----------------------------------------------------------------------
-// Directory::FindIndex
-// 	Look up file name in directory, and return its location in the table of
-//	directory entries.  Return -1 if the name isn't in the directory.
+// Directory::MaxNameLength
+// 	Return the longest name the directory can hold; of a longer name,
+//	only the first this many characters are kept, or compared.
+//----------------------------------------------------------------------
+
+int Directory::MaxNameLength()
+{
+    return FileNameMaxLen;
+}
+
+//----------------------------------------------------------------------
+// Directory::GetBlock
+// 	Return block "block" of the directory, reading it in from
+//	the directory file the first time.  A block past the end of the
+//	file has never been written, and so is empty.
+//----------------------------------------------------------------------
+
+char *Directory::GetBlock(int block)
+{
+    map<int, char *>::iterator it = blocks.find(block);
+    char *data;
+
+    if (it != blocks.end())
+        return it->second;
+    ASSERT(block > 0 && block + DirBlockSectors <= header.numSectors && file != NULL);
+    data = new char[DirBlockSectors * SectorSize];
+    memset(data, 0, DirBlockSectors * SectorSize);
+    (void)file->ReadAt(data, DirBlockSectors * SectorSize, block * SectorSize);
+    blocks[block] = data;
+    return data;
+}
+
+//----------------------------------------------------------------------
+// Directory::NewBlock
+// 	Make block "block" of the directory an empty one, without
+//	reading it in, and mark it dirty.
+//----------------------------------------------------------------------
+
+char *Directory::NewBlock(int block)
+{
+    char *data = blocks[block];
+
+    if (data == NULL)
+    {
+        data = new char[DirBlockSectors * SectorSize];
+        blocks[block] = data;
+    }
+    memset(data, 0, DirBlockSectors * SectorSize);
+    MarkDirty(block, 0, DirBlockSectors * SectorSize);
+    return data;
+}
+
+//----------------------------------------------------------------------
+// Directory::MarkDirty
+// 	Note that "length" bytes at "offset" in block "block" have
+//	changed, so that WriteBack writes the sectors holding them.
+//----------------------------------------------------------------------
+
+void Directory::MarkDirty(int block, int offset, int length)
+{
+    for (int s = offset / SectorSize; s <= (offset + length - 1) / SectorSize; s++)
+        dirtySectors.insert(block + s);
+}
+
+//----------------------------------------------------------------------
+// Directory::NumBuckets
+// 	Return how many buckets the hash table has.
+//----------------------------------------------------------------------
+
+int Directory::NumBuckets()
+{
+    return (1 << header.level) + header.split;
+}
+
+//----------------------------------------------------------------------
+// Directory::BucketOf
+// 	Return the bucket that "name" belongs in.  Buckets below "split"
+//	have been split this time round, so their entries are spread over
+//	twice as many buckets.
+//----------------------------------------------------------------------
+
+int Directory::BucketOf(char *name)
+{
+    unsigned int hash = HashName(name, MaxNameLength());
+    int bucket = hash % (1 << header.level);
+
+    if (bucket < header.split)
+        bucket = hash % (1 << (header.level + 1));
+    return bucket;
+}
+
+//----------------------------------------------------------------------
+// Directory::BucketBlock
+// 	Return the block of the directory file that holds a bucket.
+//	Segment 0 holds the first bucket, and segment s > 0 as many
+//	buckets as all the segments before it.
+//----------------------------------------------------------------------
+
+int Directory::BucketBlock(int bucket)
+{
+    int segment = 0, first = 0, size = 1;
+
+    while (bucket >= first + size)
+    {
+        segment++;
+        first += size;
+        size = first;
+    }
+    ASSERT(segment < NumSegments && header.segments[segment] != 0);
+    return header.segments[segment] + (bucket - first) * DirBlockSectors;
+}
+
+//----------------------------------------------------------------------
+// Directory::FindInBlock
+// 	Look for "name" among the entries of one block, and return where
+//	in the block its entry starts, or -1 if it is not there.
 //
+//	"data" -- the block
 //	"name" -- the file name to look up
+//	"entry" -- if not NULL, where to copy the entry found
 //----------------------------------------------------------------------
 
-int Directory::FindIndex(char *name)
+int Directory::FindInBlock(char *data, char *name, ListedEntry *entry)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
+    ListedEntry found;
+    int offset, end, size;
+
+    end = BlockHeaderSize + BytesUsed(data);
+    for (offset = BlockHeaderSize; offset < end; offset += size)
+    {
+        size = UnpackEntry(data + offset, &found);
+        if (!strncmp(found.name, name, FileNameMaxLen))
+        {
+            if (entry != NULL)
+                *entry = found;
+            return offset;
+        }
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// Directory::PutInBlock
+// 	Add an entry to a block, after the entries already there.  Return
+//	FALSE if there is no room for it.
+//
+//	"block", "data" -- the block, and its contents
+//	"entry" -- the entry to add; its name is no longer than
+//	    MaxNameLength
+//----------------------------------------------------------------------
+
+bool Directory::PutInBlock(int block, char *data, ListedEntry *entry)
+{
+    int offset, size;
+
+    offset = BlockHeaderSize + BytesUsed(data);
+    size = EntryHeaderSize + strlen(entry->name);
+    if (offset + size > DirBlockSectors * SectorSize)
+        return FALSE;
+    PackEntry(data + offset, entry);
+    BytesUsed(data) += size;
+    MarkDirty(block, 0, BlockHeaderSize);
+    MarkDirty(block, offset, size);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::TakeFromBlock
+// 	Remove the entry at "offset" in a block.  The entries after it
+//	move down to close the gap, so that the free space in a block is
+//	always at its end.
+//
+//	"block", "data" -- the block, and its contents
+//	"offset" -- where the entry starts, as returned by FindInBlock
+//----------------------------------------------------------------------
+
+void Directory::TakeFromBlock(int block, char *data, int offset)
+{
+    ListedEntry entry;
+    int size, end;
+
+    end = BlockHeaderSize + BytesUsed(data);
+    size = UnpackEntry(data + offset, &entry);
+    memmove(data + offset, data + offset + size, end - offset - size);
+    memset(data + end - size, 0, size);
+    BytesUsed(data) -= size;
+    MarkDirty(block, 0, BlockHeaderSize);
+    MarkDirty(block, offset, end - offset);
+}
+
+//----------------------------------------------------------------------
+// Directory::BlockEntries
+// 	Append every entry of a block to "entries".
+//----------------------------------------------------------------------
+
+void Directory::BlockEntries(char *data, vector<ListedEntry> *entries)
+{
+    ListedEntry entry;
+    int offset, end;
+
+    end = BlockHeaderSize + BytesUsed(data);
+    for (offset = BlockHeaderSize; offset < end;)
+    {
+        offset += UnpackEntry(data + offset, &entry);
+        entries->push_back(entry);
+    }
+}
+
+//----------------------------------------------------------------------
+// Directory::FindEntry
+// 	Look up file name in the directory, searching only the bucket
+//	it belongs in, and any overflow blocks chained after that.  Return
+//	FALSE if the name isn't in the directory.
+//
+//	"name" -- the file name to look up
+//	"entry" -- if not NULL, where to copy its entry
+//	"where", "offset" -- if not NULL, where to return the block
+//	    holding the entry, and where in the block it starts
+//----------------------------------------------------------------------
+
+bool Directory::FindEntry(char *name, ListedEntry *entry, int *where, int *offset)
+{
+    char *data;
+    int block = BucketBlock(BucketOf(name));
+    int found;
+
+    while (block != 0)
+    {
+        data = GetBlock(block);
+        found = FindInBlock(data, name, entry);
+        if (found != -1)
+        {
+            if (where != NULL)
+                *where = block;
+            if (offset != NULL)
+                *offset = found;
+            return TRUE;
+        }
+        block = NextBlock(data);
+    }
+    return FALSE; // name not in directory
+}
+
+//----------------------------------------------------------------------
+// Directory::Place
+// 	Add an entry to the bucket its name belongs in, in the first block
+//	of it with room.  If the bucket and its overflow blocks are all
+//	full, chain another overflow block after them: one given up
+//	earlier, if there is one, or else a new one at the end of the file.
+//	Return TRUE if an overflow block had to be chained.
+//----------------------------------------------------------------------
+
+bool Directory::Place(ListedEntry *entry)
+{
+    int block = BucketBlock(BucketOf(entry->name));
+    int next;
+    char *data;
+    bool fits;
+
+    for (;;)
+    {
+        data = GetBlock(block);
+        if (PutInBlock(block, data, entry))
+            return FALSE;
+        if (NextBlock(data) == 0)
+            break;
+        block = NextBlock(data);
+    }
+
+    if (header.freeBlock != 0)
+    {
+        next = header.freeBlock;
+        header.freeBlock = NextBlock(GetBlock(next));
+    }
+    else
+    {
+        next = header.numSectors;
+        header.numSectors += DirBlockSectors;
+    }
+    NextBlock(data) = next;
+    MarkDirty(block, 0, sizeof(int));
+    fits = PutInBlock(next, NewBlock(next), entry);
+    ASSERT(fits);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Split
+// 	Add a bucket to the hash table, by splitting bucket "split": its
+//	entries are shared out between it and the new bucket, according to
+//	one more bit of their hash.  The overflow blocks it had go on the
+//	chain of free ones.  The first bucket of a segment places the whole
+//	segment at the end of the file.
+//----------------------------------------------------------------------
+
+void Directory::Split()
+{
+    int oldBucket = header.split;
+    int newBucket = NumBuckets();
+    int segment, first;
+    int block, next;
+    vector<ListedEntry> moving;
+    char *data;
+
+    for (segment = 1, first = 1; newBucket >= 2 * first; segment++)
+        first *= 2;
+    if (newBucket == first)
+    {
+        ASSERT(segment < NumSegments);
+        header.segments[segment] = header.numSectors;
+        header.numSectors += first * DirBlockSectors;
+    }
+
+    // take every entry out of the old bucket
+    block = BucketBlock(oldBucket);
+    data = GetBlock(block);
+    next = NextBlock(data);
+    BlockEntries(data, &moving);
+    NewBlock(block);
+    while (next != 0)
+    {
+        block = next;
+        data = GetBlock(block);
+        next = NextBlock(data);
+        BlockEntries(data, &moving);
+        NextBlock(NewBlock(block)) = header.freeBlock;
+        header.freeBlock = block;
+    }
+
+    NewBlock(BucketBlock(newBucket));
+    header.split++;
+    if (header.split == (1 << header.level))
+    {
+        header.level++;
+        header.split = 0;
+    }
+    for (int i = 0; i < (int)moving.size(); i++)
+        (void)Place(&moving[i]);
+}
+
+//----------------------------------------------------------------------
+// Directory::Entries
+// 	Gather every entry of the directory that is in use, in the
+//	order of their numbers.
+//----------------------------------------------------------------------
+
+void Directory::Entries(vector<ListedEntry> *entries)
+{
+    char *data;
+    int block;
+
+    for (int bucket = 0; bucket < NumBuckets(); bucket++)
+        for (block = BucketBlock(bucket); block != 0; block = NextBlock(data))
+        {
+            data = GetBlock(block);
+            BlockEntries(data, entries);
+        }
+    sort(entries->begin(), entries->end(), EarlierEntry);
+}
+
+//----------------------------------------------------------------------
+// Directory::FreeOrder
+// 	Return the number to give an entry being added: the lowest one no
+//	entry has, as the original format gave it the first free slot of
+//	its table.  Unless an entry below
+//	the highest number has been removed, that is "nextOrder", and
+//	nothing has to be read; otherwise every entry is looked at.
+//----------------------------------------------------------------------
+
+int Directory::FreeOrder()
+{
+    vector<ListedEntry> entries;
+    int i;
+
+    if (header.numEntries == header.nextOrder)
+        return header.nextOrder++;
+    Entries(&entries);
+    for (i = 0; i < (int)entries.size(); i++)
+        if (entries[i].order != i)
             return i;
-    return -1; // name not in directory
+    header.nextOrder = i + 1; // the numbers free were all above
+    return i;
 }
 
 //----------------------------------------------------------------------
@@ -104,43 +651,55 @@ int Directory::FindIndex(char *name)
 //	in the directory.
 //
 //	"name" -- the file name to look up
+//	"type" -- if not NULL, where to return whether it is a file
+//	    (FILE_TYPE) or a directory (DIRECTORY_TYPE); 0 if not found
 //----------------------------------------------------------------------
 
-int Directory::Find(char *name)
+int Directory::Find(char *name, int *type)
 {
-    int i = FindIndex(name);
+    ListedEntry entry;
+    int sector = -1, found = 0;
 
-    if (i != -1)
-        return table[i].sector;
-    return -1;
+    if (FindEntry(name, &entry, NULL, NULL))
+    {
+        sector = entry.sector;
+        found = entry.type;
+    }
+    if (type != NULL)
+        *type = found;
+    return sector;
 }
 
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory.  The
+//	directory is never full; whenever it has to chain an overflow
+//	block, it gains another bucket.
+//
+//	Only the first MaxNameLength characters of the name are kept.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"file_or_dir" -- FILE_TYPE or DIRECTORY_TYPE
 //----------------------------------------------------------------------
 
 bool Directory::Add(char *name, int newSector, int file_or_dir)
 {
-    if (FindIndex(name) != -1)
-        return FALSE;
+    ListedEntry entry;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse)
-        {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen);
-            table[i].sector = newSector;
-            table[i].File_or_DIR = file_or_dir;
-            return TRUE;
-        }
-    return FALSE; // no space.  Fix when we have extensible files.
+    if (FindEntry(name, NULL, NULL, NULL))
+        return FALSE;
+    memset(&entry, 0, sizeof(ListedEntry));
+    entry.sector = newSector;
+    entry.order = FreeOrder();
+    entry.type = file_or_dir;
+    strncpy(entry.name, name, MaxNameLength());
+    header.numEntries++;
+    headerDirty = TRUE;
+    if (Place(&entry))
+        Split();
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -153,17 +712,22 @@ bool Directory::Add(char *name, int newSector, int file_or_dir)
 
 bool Directory::Remove(char *name)
 {
-    int i = FindIndex(name);
+    ListedEntry entry;
+    int block, offset;
 
-    if (i == -1)
+    if (!FindEntry(name, &entry, &block, &offset))
         return FALSE; // name not in directory
-    table[i].inUse = FALSE;
+    TakeFromBlock(block, GetBlock(block), offset);
+    header.numEntries--;
+    if (entry.order == header.nextOrder - 1)
+        header.nextOrder--;
+    headerDirty = TRUE;
 
-    printf("[%d] %s ", 0, table[i].name);
+    printf("[%d] %s ", 0, entry.name);
 
-    if (table[i].File_or_DIR == FILE_TYPE)
+    if (entry.type == FILE_TYPE)
         printf("F");
-    else if (table[i].File_or_DIR == DIRECTORY_TYPE)
+    else if (entry.type == DIRECTORY_TYPE)
         printf("D");
 
     printf("\n");
@@ -172,52 +736,48 @@ bool Directory::Remove(char *name)
 
 //----------------------------------------------------------------------
 // Directory::List
-// 	List all the file names in the directory.
+// 	List all the file names in the directory, in the order of their
+//	numbers, each with its number.
 //----------------------------------------------------------------------
 
 void Directory::List(bool recursive)
 {
-    int inUse_count = 0;
-    for (int i = 0; i < tableSize; i++)
-    {
-        if (table[i].inUse)
-        {
-            printf("[%d] %s ", i, table[i].name);
+    vector<ListedEntry> entries;
 
-            if (table[i].File_or_DIR == FILE_TYPE)
-                printf("F");
-            else if (table[i].File_or_DIR == DIRECTORY_TYPE)
-                printf("D");
+    Entries(&entries);
 
-            printf("\n");
+    for (int i = 0; i < (int)entries.size(); i++)
+    {
+        printf("[%d] %s ", entries[i].order, entries[i].name);
 
-            inUse_count++;
-        }
+        if (entries[i].type == FILE_TYPE)
+            printf("F");
+        else if (entries[i].type == DIRECTORY_TYPE)
+            printf("D");
+
+        printf("\n");
     }
-    if (inUse_count == 0)
+    if (entries.size() == 0)
         std::cout << "Empty" << std::endl;
 
     if (recursive)
     {
-        for (int i = 0; i < tableSize; i++)
+        for (int i = 0; i < (int)entries.size(); i++)
         {
-            if (table[i].inUse)
+            OpenFile *directoryFile = NULL;
+            Directory *directory = NULL;
+            if (entries[i].type == DIRECTORY_TYPE)
             {
-                OpenFile *directoryFile = NULL;
-                Directory *directory = NULL;
-                if (table[i].File_or_DIR == DIRECTORY_TYPE)
-                {
-                    std::cout << "=======================================" << std::endl;
-                    std::cout << "Dir " << table[i].name << std::endl;
-                    directoryFile = new OpenFile(table[i].sector);
-                    directory = new Directory(NumDirEntries);
-                    directory->FetchFrom(directoryFile);
-
-                    directory->List(true);
-
-                    delete directoryFile;
-                    delete directory;
-                }
+                std::cout << "=======================================" << std::endl;
+                std::cout << "Dir " << entries[i].name << std::endl;
+                directoryFile = new OpenFile(entries[i].sector);
+                directory = new Directory;
+                directory->FetchFrom(directoryFile);
+
+                directory->List(true);
+
+                delete directoryFile;
+                delete directory;
             }
         }
     }
@@ -232,15 +792,16 @@ void Directory::List(bool recursive)
 void Directory::Print()
 {
     FileHeader *hdr = new FileHeader;
+    vector<ListedEntry> entries;
 
     printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse)
-        {
-            printf("Name: %s, Sector: %d\n", table[i].name, table[i].sector);
-            hdr->FetchFrom(table[i].sector);
-            hdr->Print();
-        }
+    Entries(&entries);
+    for (int i = 0; i < (int)entries.size(); i++)
+    {
+        printf("Name: %s, Sector: %d\n", entries[i].name, entries[i].sector);
+        hdr->FetchFrom(entries[i].sector);
+        hdr->Print();
+    }
     printf("\n");
     delete hdr;
 }
@@ -6,6 +6,43 @@
 //	where to find its file header (the data structure describing
 //	where to find the file's data blocks) on disk.
 //
+//	Directories written by this file system are hash tables, so that
+//	finding or adding a name reads one bucket of the directory,
+//	however many files it holds.  The table grows by linear hashing:
+//	whenever a bucket fills up, and an overflow block has to be
+//	chained after it, one more bucket is added, and the entries of
+//	one existing bucket are split between the two.  On disk, the
+//	directory file is
+//
+//	a header sector (DirectoryHeader), then blocks of DirBlockSectors
+//	sectors each: the buckets, and the overflow blocks.
+//
+//	A block starts with the sector of the overflow block chained after
+//	it (or 0) and the number of bytes of entries it holds, and the
+//	entries follow, packed one after another.  Each entry is
+//
+//	the length of the name (one byte), its type (one byte), the sector
+//	of its header, its number in listings (four bytes each), then the
+//	name itself, without a trailing '\0'
+//
+//	so names may be up to FileNameMaxLen characters long, and a short
+//	name takes up little room.  Entries are numbered as the original
+//	format numbered them by their slot in its table: each gets the
+//	lowest number no other entry has.
+//
+//	The buckets come in runs ("segments") of consecutive blocks: the
+//	first bucket, then runs that double in size, each placed at the
+//	end of the file when its first bucket is added.  The header
+//	records where each run starts.  Blocks are numbered by their first
+//	sector in the directory file.
+//
+//	A directory written before directories were hashed is a flat table
+//	of DirectoryEntry, whose names are at most OldFileNameMaxLen
+//	characters long.  Its first word is never DirectoryMagic, which
+//	tells it apart.  FetchFrom converts such a table into a hashed
+//	directory, each entry numbered by its slot, and the first WriteBack
+//	writes that over it.
+//
 //      We assume mutual exclusion is provided by the caller.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
@@ -18,15 +55,27 @@
 #define DIRECTORY_H
 
 #include "openfile.h"
+#include "disk.h"
+#include <map>
+#include <set>
+#include <vector>
 
-#define FileNameMaxLen 9 /* for simplicity, we assume \
-                         // file names are <= 9 characters long*/
+#define FileNameMaxLen 255  // longest name a directory can hold
+#define OldFileNameMaxLen 9 // longest name, in the original format
 #define FILE_TYPE 1
 #define DIRECTORY_TYPE 2
 
+#define DirectoryMagic ((int)0x44697249)
+#define DirBlockSectors 4   // sectors per block; enough for the
+                            //  longest entry
+#define BlockHeaderSize 8   // next block, and bytes of entries
+#define EntryHeaderSize 10  // bytes of an entry before its name
+#define NumSegments (SectorSize / (int)sizeof(int) - 7)
+
 // The following class defines a "directory entry", representing a file
 // in the directory.  Each entry gives the name of the file, and where
-// the file's header is to be found on disk.
+// the file's header is to be found on disk.  This is the entry of the
+// original, flat format.
 //
 // Internal data structures kept public so that Directory operations can
 // access them directly.
@@ -34,42 +83,79 @@
 class DirectoryEntry
 {
 public:
-    bool inUse;                    // Is this directory entry in use?
-    int sector;                    // Location on disk to find the
-                                   //   FileHeader for this file
-    char name[FileNameMaxLen + 1]; // Text name for file, with +1 for
-                                   // the trailing '\0'
+    bool inUse;                       // Is this directory entry in use?
+    int sector;                       // Location on disk to find the
+                                      //   FileHeader for this file
+    char name[OldFileNameMaxLen + 1]; // Text name for file, with +1 for
+                                      // the trailing '\0'
     int File_or_DIR;
 };
 
+// An entry, as it is handed around in memory.
+
+class ListedEntry
+{
+public:
+    int sector;                    // Location of the file's FileHeader
+    int order;                     // Its number in listings, which
+                                   //  List prints, and sorts by
+    int type;                      // FILE_TYPE or DIRECTORY_TYPE
+    char name[FileNameMaxLen + 1]; // Text name for file
+};
+
+// The first sector of a directory.
+
+class DirectoryHeader
+{
+public:
+    int magic;      // DirectoryMagic
+    int level;      // the table had 1 << level buckets when the
+    int split;      //  next bucket to split, "split", was the
+                    //  first one
+    int numEntries; // entries in use
+    int nextOrder;  // above every "order" in use; the next
+                    //  one, unless some below it are free
+    int numSectors; // sectors of the directory file in use,
+                    //  counting this one
+    int freeBlock;  // first of a chain of overflow blocks no longer
+                    //  used, or 0
+    int segments[NumSegments]; // first block of each run of buckets,
+                               //  or 0 if it is not there yet
+};
+
 // The following class defines a UNIX-like "directory".  Each entry in
 // the directory describes a file, and where to find it on disk.
 //
 // The directory data structure can be stored in memory, or on disk.
 // When it is on disk, it is stored as a regular Nachos file.
 //
-// The constructor initializes a directory structure in memory; the
+// The constructor initializes an empty directory in memory; the
 // FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk.
+// from/to disk.  A directory only reads in the blocks it needs,
+// when it needs them, from the file it was fetched from.
 
 class Directory
 {
 public:
-    Directory(int size); // Initialize an empty directory
-                         // with space for "size" files
-    ~Directory();        // De-allocate the directory
+    Directory(); // Initialize an empty directory
+    ~Directory(); // De-allocate the directory
 
     void FetchFrom(OpenFile *file); // Init directory contents from disk
     void WriteBack(OpenFile *file); // Write modifications to
                                     // directory contents back to disk
 
-    int Find(char *name); // Find the sector number of the
-                          // FileHeader for file: "name"
+    int Find(char *name, int *type = NULL);
+    // Find the sector number of the
+    // FileHeader for file: "name",
+    // and its type
 
     bool Add(char *name, int newSector, int file_or_dir); // Add a file name into the directory
 
     bool Remove(char *name); // Remove a file from the directory
 
+    int MaxNameLength(); // Longest name the directory keeps;
+                         //  the rest of a longer one is ignored
+
     void List(bool recursive); // Print the names of all the files
                                //  in the directory
     void Print();              // Verbose print of the contents
@@ -84,12 +170,43 @@ private:
 		In-core part: tableSize
 	*/
 
-    int tableSize;         // Number of directory entries
-    DirectoryEntry *table; // Table of pairs:
-                           // <file name, file header location>
-
-    int FindIndex(char *name); // Find the index into the directory
-                               //  table corresponding to "name"
+    void Clear();     // Forget the directory's contents
+    void MakeEmpty(); // Start over with no entries
+    void Convert(DirectoryEntry *table, int tableSize);
+    // Take the entries of a flat table
+
+    DirectoryHeader header;
+    map<int, char *> blocks;    // blocks read in, or changed
+    set<int> dirtySectors;      // sectors of them changed since the
+                                //  last FetchFrom or WriteBack
+    bool headerDirty;           // has "header" changed?
+    OpenFile *file;             // where to read the others from
+
+    char *GetBlock(int block);  // Read in a block, if need be
+    char *NewBlock(int block);  // An empty, dirty block, not read in
+    void MarkDirty(int block, int offset, int length);
+    // Bytes of a block have changed
+    int NumBuckets();            // Buckets in the table
+    int BucketOf(char *name);    // Bucket "name" belongs in
+    int BucketBlock(int bucket); // Block holding a bucket
+
+    int FindInBlock(char *data, char *name, ListedEntry *entry);
+    // Where "name" is in a block, or -1
+    bool PutInBlock(int block, char *data, ListedEntry *entry);
+    // Add an entry to a block, if it fits
+    void TakeFromBlock(int block, char *data, int offset);
+    // Remove the entry at "offset"
+    void BlockEntries(char *data, vector<ListedEntry> *entries);
+    // Every entry of a block
+
+    bool FindEntry(char *name, ListedEntry *entry, int *block, int *offset);
+    // Find "name" in its bucket
+    bool Place(ListedEntry *entry); // Put an entry in its bucket
+    void Split();                   // Add a bucket
+    void Entries(vector<ListedEntry> *entries);
+    // All the entries in use, in the
+    //  order of their numbers
+    int FreeOrder(); // Number for an entry being added
 };
 
 #endif // DIRECTORY_H
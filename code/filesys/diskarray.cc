@@ -0,0 +1,136 @@
+// diskarray.cc
+//	Routines shared by volumes built out of several simulated disks.
+//
+//	The array also times how long the volume as a whole is busy --
+//	that is, has at least one piece queued or in progress on some
+//	disk -- so that the stats can show how much of that time the
+//	disks spent working side by side.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "diskarray.h"
+
+//----------------------------------------------------------------------
+// RequestPieces::RequestPieces
+// 	Start keeping track of the pieces of a volume request; there are
+//	none yet.
+//----------------------------------------------------------------------
+
+RequestPieces::RequestPieces(DiskArray *array, DiskRequest *request)
+{
+    this->array = array;
+    this->request = request;
+    remaining = 0;
+}
+
+//----------------------------------------------------------------------
+// RequestPieces::CallBack
+// 	A piece has completed.  If it was the last one, tell whoever made
+//	the volume request, and delete it.
+//----------------------------------------------------------------------
+
+void
+RequestPieces::CallBack()
+{
+    array->PieceDone();
+    if (--remaining > 0)
+        return;
+    request->whenDone->CallBack();
+    delete request;
+    delete this;
+}
+
+//----------------------------------------------------------------------
+// DiskArray::DiskArray
+// 	Initialize the disks of an array, each with its own queue.
+//
+//	"numDisks" -- how many disks
+//	"policy" -- the order in which each disk's queue serves requests
+//	"mapped" -- map the disks' UNIX files into memory
+//	"model" -- how long each disk takes to serve a request
+//	"offline" -- a disk to leave out, or -1
+//----------------------------------------------------------------------
+
+DiskArray::DiskArray(int numDisks, DiskPolicy policy, bool mapped,
+                     DiskModel model, int offline)
+{
+    ASSERT(numDisks > 0);
+    this->numDisks = numDisks;
+    disks = new DiskQueue *[numDisks];
+    for (int i = 0; i < numDisks; i++)
+        disks[i] = (i == offline) ? NULL : new DiskQueue(policy, mapped, model, i);
+    outstanding = 0;
+    busySince = 0;
+    kernel->stats->numDisks = numDisks;
+}
+
+//----------------------------------------------------------------------
+// DiskArray::~DiskArray
+// 	De-allocate the disks.
+//----------------------------------------------------------------------
+
+DiskArray::~DiskArray()
+{
+    for (int i = 0; i < numDisks; i++)
+        delete disks[i];
+    delete [] disks;
+}
+
+//----------------------------------------------------------------------
+// DiskArray::Sync
+// 	Make sure that everything written so far has reached every disk's
+//	UNIX file.
+//----------------------------------------------------------------------
+
+void
+DiskArray::Sync()
+{
+    for (int i = 0; i < numDisks; i++)
+        if (disks[i] != NULL)
+            disks[i]->Sync();
+}
+
+//----------------------------------------------------------------------
+// DiskArray::SubmitPiece
+// 	Queue one piece of a volume request with one of the disks.  Called
+//	with interrupts off, so that no piece can complete before all the
+//	pieces of the request have been counted.
+//
+//	"disk" -- which disk
+//	"sector" -- the first sector of the piece, on that disk
+//	"data" -- data[i] is the buffer for sector + i
+//	"numSectors" -- how many sectors are in the piece
+//	"writing" -- write the buffers, rather than read into them
+//	"pieces" -- the request the piece belongs to
+//----------------------------------------------------------------------
+
+void
+DiskArray::SubmitPiece(int disk, int sector, char **data, int numSectors,
+                       bool writing, RequestPieces *pieces)
+{
+    ASSERT(kernel->interrupt->getLevel() == IntOff);
+    ASSERT(disks[disk] != NULL);
+    if (outstanding++ == 0)
+        busySince = kernel->stats->totalTicks;
+    pieces->remaining++;
+    disks[disk]->Submit(new DiskRequest(sector, data, numSectors, writing,
+                                        pieces));
+}
+
+//----------------------------------------------------------------------
+// DiskArray::PieceDone
+// 	Note that a piece has completed, adding to the volume's busy time
+//	if it was the last one outstanding.
+//----------------------------------------------------------------------
+
+void
+DiskArray::PieceDone()
+{
+    if (--outstanding == 0)
+        kernel->stats->volumeBusyTicks += kernel->stats->totalTicks - busySince;
+}
@@ -0,0 +1,68 @@
+// diskarray.h
+//	Data structures shared by volumes built out of several simulated
+//	disks (striped or mirrored).
+//
+//	Each disk of the array has its own queue, so that the disks work
+//	at the same time.  A request to the volume is turned into pieces,
+//	each a request to one of the disks; the volume request completes
+//	once the last of its pieces does.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DISKARRAY_H
+#define DISKARRAY_H
+
+#include "copyright.h"
+#include "diskqueue.h"
+
+class DiskArray;
+
+// The pieces a volume request was split into.  Completes the volume
+// request once all of them are done.
+
+class RequestPieces : public CallBackObj
+{
+public:
+    RequestPieces(DiskArray *array, DiskRequest *request);
+
+    void CallBack(); // One more piece is done
+
+    int remaining;   // pieces not done yet
+
+private:
+    DiskArray *array;
+    DiskRequest *request; // the request they were split from
+};
+
+// The following class defines what every disk array has in common.
+
+class DiskArray : public BlockDevice
+{
+public:
+    DiskArray(int numDisks, DiskPolicy policy, bool mapped, DiskModel model,
+              int offline = -1);
+    // Create "numDisks" disks, named
+    //  DISK_<host>a, DISK_<host>b, ...,
+    //  except disk "offline", if any;
+    //  the rest is as for DiskQueue
+    virtual ~DiskArray();
+
+    void Sync(); // Sync every disk
+
+protected:
+    friend class RequestPieces;
+    void SubmitPiece(int disk, int sector, char **data, int numSectors,
+                     bool writing, RequestPieces *pieces);
+    // Queue a piece with one disk.
+    //  Call with interrupts off.
+    void PieceDone(); // Note that a piece has completed
+
+    int numDisks;      // how many disks
+    DiskQueue **disks; // each disk, with its queue; NULL if offline
+    int outstanding;   // pieces queued or in progress
+    int busySince;     // when "outstanding" last became non-zero
+};
+
+#endif // DISKARRAY_H
@@ -0,0 +1,309 @@
+// diskqueue.cc
+//	Routines to queue and schedule requests to the raw disk.
+//
+//	The queue is shared between threads and the disk interrupt
+//	handler, so it is only touched with interrupts off.
+//
+//	The policies judge a request by where it is on the disk, using
+//	the disk's own timing model: SSTF picks the request that
+//	Disk::ComputeLatency says can be reached soonest, and SCAN picks
+//	the soonest among those on tracks ahead of the head.  C-LOOK just
+//	takes the next higher sector, wrapping round to the lowest.
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "diskqueue.h"
+
+//----------------------------------------------------------------------
+// DiskRequest::DiskRequest
+// 	Set up a request to read or write a run of consecutive sectors.
+//
+//	"sector" -- the first sector of the run
+//	"data" -- data[i] is the buffer for sector + i
+//	"numSectors" -- how many sectors are in the run
+//	"writing" -- write the buffers to disk, rather than read into them
+//	"whenDone" -- called once the request has completed
+//----------------------------------------------------------------------
+
+DiskRequest::DiskRequest(int sector, char **data, int numSectors, 
+                         bool writing, CallBackObj *whenDone)
+{
+    this->sector = sector;
+    this->numSectors = numSectors;
+    this->writing = writing;
+    this->data.assign(data, data + numSectors);
+    this->whenDone = whenDone;
+    queuedAt = 0;
+}
+
+//----------------------------------------------------------------------
+// DiskRequest::Overlaps
+// 	Return TRUE if this request and "other" touch any of the same
+//	sectors.
+//----------------------------------------------------------------------
+
+bool
+DiskRequest::Overlaps(DiskRequest *other)
+{
+    return sector < other->sector + other->numSectors 
+        && other->sector < sector + numSectors;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::DiskQueue
+// 	Initialize the raw disk, and an empty queue in front of it.
+//
+//	"policy" -- the order in which to send requests to the disk
+//	"mapped" -- map the disk's UNIX file into memory
+//	"model" -- how long the disk takes to serve a request
+//	"member" -- which disk of an array this is, or -1 if it is the
+//		only one
+//----------------------------------------------------------------------
+
+DiskQueue::DiskQueue(DiskPolicy policy, bool mapped, DiskModel model,
+                     int member)
+{
+    this->policy = policy;
+    disk = new Disk(this, mapped, model, member);
+    headSector = 0;
+    activeUntil = 0;
+    sweepingUp = TRUE;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::~DiskQueue
+// 	De-allocate the disk, and any requests still queued.
+//----------------------------------------------------------------------
+
+DiskQueue::~DiskQueue()
+{
+    for (int i = 0; i < (int)pending.size(); i++)
+        delete pending[i];
+    for (int i = 0; i < (int)active.size(); i++)
+        delete active[i];
+    delete disk;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::ParsePolicy
+// 	Look up a scheduling policy by name.  Return FALSE if there is no
+//	such policy.
+//
+//	"name" -- one of "fcfs", "sstf", "scan" or "clook"
+//	"policy" -- where to put the policy
+//----------------------------------------------------------------------
+
+bool
+DiskQueue::ParsePolicy(char *name, DiskPolicy *policy)
+{
+    if (strcmp(name, "fcfs") == 0)
+        *policy = FCFS;
+    else if (strcmp(name, "sstf") == 0)
+        *policy = SSTF;
+    else if (strcmp(name, "scan") == 0)
+        *policy = SCAN;
+    else if (strcmp(name, "clook") == 0)
+        *policy = CLOOK;
+    else
+        return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Submit
+// 	Queue a request, and send it to the disk straight away if the
+//	disk has nothing else to do.  Return without waiting for it.  The
+//	queue owns the request from now on, and deletes it after calling
+//	its "whenDone".
+//----------------------------------------------------------------------
+
+void
+DiskQueue::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    int depth;
+
+    request->queuedAt = kernel->stats->totalTicks;
+    pending.push_back(request);
+    depth = pending.size() + active.size();
+    kernel->stats->numDiskRequests++;
+    kernel->stats->totalDiskQueueDepth += depth;
+    kernel->stats->maxDiskQueueDepth = max(kernel->stats->maxDiskQueueDepth, depth);
+    if (active.empty())
+        StartNext();
+    kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::PredictLatency
+// 	Estimate how long a request submitted now would take to complete:
+//	the rest of the request the disk is working on, then each queued
+//	request in turn, then this one.  Each queued request is costed as
+//	if it started from where the head is now, which is only a guess,
+//	but one that grows with the length of the queue, as it should.
+//
+//	"sector" -- the first sector of the run
+//	"writing" -- is the request a write?
+//	"numSectors" -- how many sectors are in the run
+//----------------------------------------------------------------------
+
+int
+DiskQueue::PredictLatency(int sector, bool writing, int numSectors)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    int latency = 0;
+
+    if (!active.empty())
+        latency += activeUntil - kernel->stats->totalTicks;
+    for (int i = 0; i < (int)pending.size(); i++)
+        latency += disk->ComputeLatency(pending[i]->sector, pending[i]->writing,
+                                        pending[i]->numSectors);
+    latency += disk->ComputeLatency(sector, writing, numSectors);
+    kernel->interrupt->SetLevel(oldLevel);
+    return latency;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Eligible
+// 	Return TRUE if pending[i] does not have to wait for an earlier
+//	request: that is, unless an earlier request touches one of its
+//	sectors, and one of the two is a write.
+//----------------------------------------------------------------------
+
+bool
+DiskQueue::Eligible(int i)
+{
+    for (int j = 0; j < i; j++)
+        if ((pending[i]->writing || pending[j]->writing) 
+                && pending[i]->Overlaps(pending[j]))
+            return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::Choose
+// 	Return the index in "pending" of the request to send to the disk
+//	next, according to the scheduling policy.  There must be at least
+//	one pending request.
+//----------------------------------------------------------------------
+
+int
+DiskQueue::Choose()
+{
+    int headTrack = headSector / SectorsPerTrack;
+    int best = -1, bestCost = 0, lowest = -1;
+    int i, cost, track;
+
+    for (int pass = 0; pass < 2 && best == -1; pass++) {
+        for (i = 0; i < (int)pending.size(); i++) {
+            if (!Eligible(i))
+                continue;
+            if (policy == FCFS)
+                return i;
+
+            track = pending[i]->sector / SectorsPerTrack;
+            if (lowest == -1 || pending[i]->sector < pending[lowest]->sector)
+                lowest = i;
+            if (policy == SCAN && (sweepingUp ? track < headTrack : track > headTrack))
+                continue;			// behind the head
+            if (policy == CLOOK && pending[i]->sector < headSector)
+                continue;			// behind the head
+
+            if (policy == CLOOK)
+                cost = pending[i]->sector - headSector;
+            else
+                cost = disk->ComputeLatency(pending[i]->sector, pending[i]->writing, 1);
+            if (best == -1 || cost < bestCost) {
+                best = i;
+                bestCost = cost;
+            }
+        }
+        if (best == -1 && policy == SCAN)
+            sweepingUp = !sweepingUp;		// turn round, and look again
+        else if (best == -1 && policy == CLOOK)
+            best = lowest;			// back to the start
+    }
+    ASSERT(best != -1);
+    return best;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::StartNext
+// 	Take the next request off the queue, merge any adjacent queued
+//	requests into it, and send the lot to the disk as one run.  Called
+//	with interrupts off, when the disk is idle.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::StartNext()
+{
+    DiskRequest *request;
+    int i, start, end;
+    bool merged = TRUE;
+
+    if (pending.empty())
+        return;
+    i = Choose();
+    request = pending[i];
+    pending.erase(pending.begin() + i);
+    active.push_back(request);
+    start = request->sector;
+    end = start + request->numSectors;
+
+    while (merged) {
+        merged = FALSE;
+        for (i = 0; i < (int)pending.size() && !merged; i++) {
+            DiskRequest *next = pending[i];
+
+            if (next->writing != request->writing || !Eligible(i))
+                continue;
+            if (next->sector == end) {			// just after
+                active.push_back(next);
+                end += next->numSectors;
+            } else if (next->sector + next->numSectors == start) {	// just before
+                active.insert(active.begin(), next);
+                start = next->sector;
+            } else
+                continue;
+            pending.erase(pending.begin() + i);
+            kernel->stats->numDiskMerges++;
+            merged = TRUE;
+        }
+    }
+
+    buffers.clear();
+    for (i = 0; i < (int)active.size(); i++)
+        buffers.insert(buffers.end(), active[i]->data.begin(), active[i]->data.end());
+    DEBUG(dbgDisk, "Disk queue sending " << active.size() << " requests, " << (end - start) << " sectors at " << start);
+    activeUntil = kernel->stats->totalTicks 
+                    + disk->ComputeLatency(start, request->writing, end - start);
+    if (request->writing)
+        disk->WriteRequest(start, &buffers[0], end - start);
+    else
+        disk->ReadRequest(start, &buffers[0], end - start);
+    headSector = end - 1;
+}
+
+//----------------------------------------------------------------------
+// DiskQueue::CallBack
+// 	Disk interrupt handler.  Start the next request, then tell
+//	everyone whose request just finished.
+//----------------------------------------------------------------------
+
+void
+DiskQueue::CallBack()
+{
+    vector<DiskRequest *> done = active;
+    int latency;
+
+    active.clear();
+    StartNext();
+    for (int i = 0; i < (int)done.size(); i++) {
+        latency = kernel->stats->totalTicks - done[i]->queuedAt;
+        kernel->stats->totalDiskLatency += latency;
+        kernel->stats->maxDiskLatency = max(kernel->stats->maxDiskLatency, latency);
+        done[i]->whenDone->CallBack();
+        delete done[i];
+    }
+}
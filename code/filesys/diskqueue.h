@@ -0,0 +1,121 @@
+// diskqueue.h
+//	Data structures for queueing requests to the raw disk.
+//
+//	The physical disk takes one request at a time.  The disk queue
+//	accepts any number: each request is queued, and the queue hands
+//	them to the disk one after another, in the order chosen by its
+//	scheduling policy, calling each request's "whenDone" object once
+//	it has completed.  Submitting a request never waits.
+//
+//	When a request is sent to the disk, any other queued requests in
+//	the same direction (read or write) for the sectors just before or
+//	just after it are merged into it, so that the disk sees one longer
+//	run instead.
+//
+//	Requests that touch the same sector, when at least one of them is
+//	a write, always reach the disk in the order they were submitted,
+//	whatever the policy.
+
+#ifndef DISKQUEUE_H
+#define DISKQUEUE_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "callback.h"
+#include <vector>
+
+// The order in which queued requests are sent to the disk.
+
+enum DiskPolicy {
+    FCFS,  // first come, first served
+    SSTF,  // shortest seek (and rotation) time first
+    SCAN,  // sweep back and forth across the tracks
+    CLOOK  // sweep upward only, then jump back to the lowest request
+};
+
+// One request to read or write a run of consecutive sectors.
+
+class DiskRequest
+{
+public:
+    DiskRequest(int sector, char **data, int numSectors, bool writing,
+                CallBackObj *whenDone);
+
+    int sector;            // first sector of the run
+    int numSectors;        // how many sectors
+    bool writing;          // write, or read?
+    vector<char *> data;   // data[i] is the buffer for sector + i
+    CallBackObj *whenDone; // told when the request has completed
+    int queuedAt;          // when the request was submitted
+
+    bool Overlaps(DiskRequest *other); // do the runs share a sector?
+};
+
+// The interface through which SynchDisk reaches the storage: a single
+// disk queue, or a volume built out of several of them.
+
+class BlockDevice
+{
+public:
+    virtual ~BlockDevice() {}
+
+    virtual void Submit(DiskRequest *request) = 0;
+    // Start a request, and return
+    //  without waiting for it.  The
+    //  device deletes the request
+    //  after calling its "whenDone".
+    virtual void Sync() = 0; // Make sure what has been written
+                             //  is in the disks' UNIX files
+};
+
+// The following class defines the disk queue.
+
+class DiskQueue : public BlockDevice, public CallBackObj
+{
+public:
+    DiskQueue(DiskPolicy policy, bool mapped, DiskModel model,
+              int member = -1);
+    // Create the disk, with an empty
+    //  queue; "mapped" maps its file,
+    //  "model" times its requests, and
+    //  "member" numbers it in an array
+    ~DiskQueue();
+
+    void Submit(DiskRequest *request); // Queue a request, and start it if
+                                       //  the disk is idle.  The request
+                                       //  is deleted once it is done.
+
+    void CallBack(); // Called when the disk finishes a request
+
+    void Sync() { disk->Sync(); } // Make sure what has been written
+                                  //  is in the disk's UNIX file
+
+    bool NewDisk() { return disk->Created(); } // Did the disk's UNIX
+                                               //  file have to be made?
+
+    int PredictLatency(int sector, bool writing, int numSectors);
+    // Roughly how long a request
+    //  submitted now would take to
+    //  complete
+
+    static bool ParsePolicy(char *name, DiskPolicy *policy);
+    // Turn "fcfs", "sstf", "scan" or
+    //  "clook" into a policy
+
+private:
+    int Choose();        // Index of the next request to send
+    bool Eligible(int i); // Can pending[i] go before the requests
+                          //  queued ahead of it?
+    void StartNext();    // Send the next request(s) to the disk
+
+    Disk *disk;                  // the raw disk
+    DiskPolicy policy;           // how to choose the next request
+    vector<DiskRequest *> pending; // requests not yet sent to the disk
+    vector<DiskRequest *> active;  // requests the disk is working on
+    vector<char *> buffers;        // buffers for the sectors of "active"
+    int headSector;              // where the last request ended
+    int activeUntil;             // when the disk will finish "active"
+    bool sweepingUp;             // SCAN: moving toward higher tracks?
+};
+
+#endif // DISKQUEUE_H
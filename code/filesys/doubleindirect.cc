@@ -8,11 +8,16 @@
 DoubleIndirect::DoubleIndirect()
 {
     memset(SISectors, -1, sizeof(SISectors));
+    table = NULL;
+    numSingleIndirect = 0;
 }
 
-DoubleIndirect::~DoubleIndirect() {}
+DoubleIndirect::~DoubleIndirect()
+{
+    delete[] table;
+}
 
-bool DoubleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount)
+bool DoubleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount, int *goal)
 {
     int numSectors = sectorAmount;
 
@@ -22,13 +27,7 @@ bool DoubleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount)
         return FALSE; // not enough space
 
     // for original inode
-    for (int i = 0; i < numSingleIndirect; i++)
-    {
-        SISectors[i] = freeMap->FindAndSet();
-        // since we checked that there was enough free space,
-        // we expect this to succeed
-        ASSERT(SISectors[i] >= 0);
-    }
+    *goal = freeMap->AllocateSectors(SISectors, numSingleIndirect, *goal);
 
     // for singleIndirect
     if (numSingleIndirect)
@@ -37,9 +36,9 @@ bool DoubleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount)
     {
         //table[i] = SingleIndirect();
         if (numSectors > SISize)
-            table[i].Allocate(freeMap, SISize);
+            table[i].Allocate(freeMap, SISize, goal);
         else
-            table[i].Allocate(freeMap, numSectors);
+            table[i].Allocate(freeMap, numSectors, goal);
 
         numSectors = numSectors - SISize;
     }
@@ -18,6 +18,17 @@
 //	     to point to the newly allocated data blocks
 //	   for a file already on disk, by reading the file header from disk
 //
+//	New files are described by extents -- runs of contiguous sectors --
+//	so a file laid out in one piece needs nothing beyond its header
+//	sector.  Headers in the original pointer format are still read,
+//	so that disks formatted before extents were added still work; one
+//	without indirect blocks is rewritten as extents when its file grows.
+//
+//	Reading a header from disk does not read its indirect blocks.
+//	Those are faulted in one sector at a time by ByteToSector and kept
+//	in a small LRU cache, so opening a file costs one disk read no
+//	matter how large the file is.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
 // of liability and disclaimer of warranty provisions.
@@ -44,18 +55,128 @@ FileHeader::FileHeader()
     numSectors = -1;
     memset(dataSectors, -1, sizeof(dataSectors));
     memset(tripleIndirectSectors, -1, sizeof(tripleIndirectSectors));
+    table = NULL;
+    numTripleIndirect = 0;
+    indexCache = NULL;
+    for (int i = 0; i < NumCachedIndex; i++)
+        cachedSector[i] = -1;
+    useClock = 0;
+    extentFormat = FALSE;
+    numExtents = 0;
+    overflowSector = -1;
+    hintExtent = hintBase = 0;
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileHeader::~FileHeader
-//	Currently, there is not need to do anything in destructor function.
-//	However, if you decide to add some "in-core" data in header
-//	Always remember to deallocate their space or you will leak memory
+//	Free the in-core index tree and the index block cache.
 //----------------------------------------------------------------------
 FileHeader::~FileHeader()
 {
-    // nothing to do now
+    FreeIndex();
+    delete[] indexCache;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeIndex
+// 	Forget every index block we have in memory, either because the
+//	header is being reused for another file, or because it is going away.
+//----------------------------------------------------------------------
+
+void FileHeader::FreeIndex()
+{
+    delete[] table;
+    table = NULL;
+    for (int i = 0; i < NumCachedIndex; i++)
+        cachedSector[i] = -1;
+    extents.clear();
+    overflowSectors.clear();
+    hintExtent = hintBase = 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadIndex
+// 	Read in the complete index tree of the file.  Only needed by
+//	operations that visit every block anyway, such as Deallocate.
+//----------------------------------------------------------------------
+
+void FileHeader::LoadIndex()
+{
+    if (table != NULL || numSectors <= NumDirect)
+        return;
+
+    numIndirect = numSectors - NumDirect;
+    size = pow(SectorSize / sizeof(int), 3); // sectors per TripleIndirect
+    numTripleIndirect = numIndirect / size + !!(numIndirect % size);
+
+    table = new TripleIndirect[numTripleIndirect];
+    for (int i = 0; i < numTripleIndirect; i++)
+    {
+        table[i].FetchFrom(tripleIndirectSectors[i]);
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadExtents
+// 	Read in the overflow blocks of an extent format header, so that
+//	the whole extent list is in memory.  Only the inline extents are
+//	read with the header, which is all most files have.
+//----------------------------------------------------------------------
+
+void FileHeader::LoadExtents()
+{
+    int buf[PointersPerIndex];
+    int next = overflowSector;
+
+    while ((int)extents.size() < numExtents)
+    {
+        ASSERT(next >= 0 && next < NumSectors);
+        DEBUG(dbgFile, "Reading overflow extent block " << next);
+        kernel->synchDisk->ReadSector(next, (char *)buf);
+        overflowSectors.push_back(next);
+
+        Extent *blockExtents = (Extent *)(buf + 2);
+        extents.insert(extents.end(), blockExtents, blockExtents + buf[1]);
+        next = buf[0];
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::IndexBlock
+// 	Return the sector numbers stored in the index block at "sector",
+//	reading it from disk only if it is not already cached.  When the
+//	cache is full the least recently used block is replaced.
+//
+//	"sector" is the disk sector containing the index block
+//----------------------------------------------------------------------
+
+int *FileHeader::IndexBlock(int sector)
+{
+    int victim = 0;
+
+    if (indexCache == NULL)
+        indexCache = new int[NumCachedIndex * PointersPerIndex];
+
+    useClock++;
+    for (int i = 0; i < NumCachedIndex; i++)
+    {
+        if (cachedSector[i] == sector)
+        {
+            lastUsed[i] = useClock;
+            return indexCache + i * PointersPerIndex;
+        }
+        if (cachedSector[i] == -1)
+            lastUsed[i] = 0; // empty slots go first
+        if (lastUsed[i] < lastUsed[victim])
+            victim = i;
+    }
+
+    DEBUG(dbgFile, "Faulting in index block " << sector);
+    kernel->synchDisk->ReadSector(sector, (char *)(indexCache + victim * PointersPerIndex));
+    cachedSector[victim] = sector;
+    lastUsed[victim] = useClock;
+    return indexCache + victim * PointersPerIndex;
 }
 
 //----------------------------------------------------------------------
@@ -65,62 +186,158 @@ FileHeader::~FileHeader()
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	Sectors are handed out as contiguous runs, in file order, so that
+//	reading the file sequentially moves the disk head as little as
+//	possible.  Each run becomes one extent of the header.
+//
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
+//	"goal" is the sector we would like the file's data to start at,
+//	    usually just past the file header
 //----------------------------------------------------------------------
 
-bool FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
+bool FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize, int goal)
 {
-    numBytes = fileSize;
-    int numDirect;
-    numSectors = divRoundUp(fileSize, SectorSize);
-    if (numSectors > NumDirect)
-    {
-        numDirect = NumDirect;
-        numIndirect = numSectors - NumDirect;
-    }
-    else
+    // start out as an empty inline file, and grow from there
+    FreeIndex();
+    extentFormat = TRUE;
+    numBytes = 0;
+    numSectors = 0;
+    numExtents = 0;
+    overflowSector = -1;
+    memset(inlineData, 0, sizeof(inlineData));
+
+    return Extend(freeMap, fileSize, goal);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Grow the file to "newSize" bytes.  Small files stay inline in the
+//	header; once a file outgrows the header it is given data sectors,
+//	and its inline contents move to the first of them.  New sectors are
+//	taken as contiguous runs following the end of the file, so that a
+//	file that is appended to still ends up in few extents.
+//
+//	A header in the old format is first rewritten as extents (see
+//	ToExtents), if it can be.
+//
+//	Return FALSE, leaving the file unchanged, if there is not enough
+//	free space, or if the header is in the old format and has indirect
+//	blocks.  The caller must write the header back.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"newSize" is the new length of the file, in bytes
+//	"goal" is where to put the data if the file has none yet,
+//	    usually just past the file header
+//----------------------------------------------------------------------
+
+bool FileHeader::Extend(PersistentBitmap *freeMap, int newSize, int goal)
+{
+    if (newSize <= numBytes)
+        return TRUE;
+    if (!extentFormat && !ToExtents())
+        return FALSE;
+
+    int newSectors = (newSize <= MaxInlineBytes && numSectors == 0)
+                         ? 0 : divRoundUp(newSize, SectorSize);
+    int more = newSectors - numSectors;
+    if (more == 0)
     {
-        numDirect = numSectors;
-        numIndirect = 0;
+        numBytes = newSize;
+        return TRUE;
     }
-
-    size = pow(SectorSize / sizeof(int), 3); // sectors per TripleIndirect
-    numTripleIndirect = numIndirect / size + !!(numIndirect % size);
-    if (freeMap->NumClear() < numDirect + numTripleIndirect + numIndirect)
+    if (freeMap->NumClear() < more)
         return FALSE; // not enough space
 
-    // if (numSectors <= NumDirect)
-    // {
-    for (int i = 0; i < numDirect; i++)
+    LoadExtents();
+    int oldExtents = extents.size();
+    int oldLength = (oldExtents > 0) ? extents.back().length : 0;
+    vector<Extent> added;
+
+    if (oldExtents > 0)
+        goal = extents.back().start + extents.back().length;
+    for (int done = 0; done < more;)
     {
-        dataSectors[i] = freeMap->FindAndSet();
-        // since we checked that there was enough free space,
-        // we expect this to succeed
-        ASSERT(dataSectors[i] >= 0);
+        Extent extent;
+        extent.start = freeMap->AllocateRun(more - done, goal, &extent.length);
+        ASSERT(extent.start >= 0); // we checked there was enough space
+        added.push_back(extent);
+        if (!extents.empty() && extents.back().start + extents.back().length == extent.start)
+            extents.back().length += extent.length; // carries on the last extent
+        else
+            extents.push_back(extent);
+        done += extent.length;
+        goal = extent.start + extent.length;
     }
 
-    // for original inode
-    for (int i = 0; i < numTripleIndirect; i++)
+    // extents that do not fit in the header go in overflow blocks
+    int numOverflow = 0;
+    if ((int)extents.size() > NumInlineExtents)
+        numOverflow = divRoundUp(extents.size() - NumInlineExtents, ExtentsPerBlock);
+    if (freeMap->NumClear() < numOverflow - (int)overflowSectors.size())
+    {
+        for (int i = 0; i < (int)added.size(); i++)
+            for (int j = 0; j < added[i].length; j++)
+                freeMap->Clear(added[i].start + j);
+        extents.resize(oldExtents);
+        if (oldExtents > 0)
+            extents.back().length = oldLength;
+        return FALSE;
+    }
+    while ((int)overflowSectors.size() < numOverflow)
     {
-        tripleIndirectSectors[i] = freeMap->FindAndSet();
+        int length;
+        int sector = freeMap->AllocateRun(1, goal, &length);
+        ASSERT(sector >= 0);
+        overflowSectors.push_back(sector);
+        goal = sector + 1;
+    }
+    overflowSector = overflowSectors.empty() ? -1 : overflowSectors[0];
 
-        ASSERT(tripleIndirectSectors[i] >= 0);
+    if (numSectors == 0 && numBytes > 0)
+    {
+        // the data has outgrown the header
+        char block[SectorSize];
+        memset(block, 0, SectorSize);
+        memcpy(block, inlineData, numBytes);
+        kernel->synchDisk->WriteSector(extents[0].start, block);
     }
+    numBytes = newSize;
+    numSectors = newSectors;
+    numExtents = extents.size();
+    return TRUE;
+}
 
-    // for singleIndirect
-    if (numTripleIndirect)
-        table = new TripleIndirect[numTripleIndirect];
-    for (int i = 0; i < numTripleIndirect; i++)
+//----------------------------------------------------------------------
+// FileHeader::ToExtents
+// 	Describe the data sectors of an old format header as extents, so
+//	that the file can grow; the data stays where it is.  Only the
+//	direct blocks can be converted this way, so return FALSE, changing
+//	nothing, if the header has indirect blocks.
+//----------------------------------------------------------------------
+
+bool FileHeader::ToExtents()
+{
+    Extent extent;
+
+    if (numSectors > NumDirect)
+        return FALSE;
+    FreeIndex();
+    for (int i = 0; i < numSectors; i++)
     {
-        //table[i] = SingleIndirect();
-        if (numIndirect > size)
-            table[i].Allocate(freeMap, size);
+        if (!extents.empty() && extents.back().start + extents.back().length == dataSectors[i])
+            extents.back().length++; // carries on the last extent
         else
-            table[i].Allocate(freeMap, numIndirect);
-
-        numIndirect = numIndirect - size;
+        {
+            extent.start = dataSectors[i];
+            extent.length = 1;
+            extents.push_back(extent);
+        }
     }
+    extentFormat = TRUE;
+    numExtents = extents.size();
+    overflowSector = -1;
+    memset(inlineData, 0, sizeof(inlineData));
     return TRUE;
 }
 
@@ -133,8 +350,24 @@ bool FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize)
 
 void FileHeader::Deallocate(PersistentBitmap *freeMap)
 {
-    //
-    if (numSectors <= NumDirect)
+    if (extentFormat)
+    {
+        LoadExtents();
+        for (int i = 0; i < (int)extents.size(); i++)
+        {
+            for (int j = 0; j < extents[i].length; j++)
+            {
+                ASSERT(freeMap->Test(extents[i].start + j)); // ought to be marked!
+                freeMap->Clear(extents[i].start + j);
+            }
+        }
+        for (int i = 0; i < (int)overflowSectors.size(); i++)
+        {
+            ASSERT(freeMap->Test(overflowSectors[i])); // ought to be marked!
+            freeMap->Clear(overflowSectors[i]);
+        }
+    }
+    else if (numSectors <= NumDirect)
     {
         for (int i = 0; i < numSectors; i++)
         {
@@ -144,10 +377,7 @@ void FileHeader::Deallocate(PersistentBitmap *freeMap)
     }
     else
     {
-        numIndirect = numSectors - NumDirect;
-        size = pow(SectorSize / sizeof(int), 3); // sectors per TripleIndirect
-        numTripleIndirect = numIndirect / size + !!(numIndirect % size);
-
+        LoadIndex();
         for (int i = 0; i < numTripleIndirect; i++)
         {
             table[i].Deallocate(freeMap);
@@ -170,24 +400,33 @@ void FileHeader::Deallocate(PersistentBitmap *freeMap)
 
 void FileHeader::FetchFrom(int sector)
 {
-    kernel->synchDisk->ReadSector(sector, (char *)this);
+    int buf[PointersPerIndex];
 
-    if (numSectors > NumDirect)
-    {
-        numIndirect = numSectors - NumDirect;
-        size = pow(SectorSize / sizeof(int), 3); // sectors per TripleIndirect
-        numTripleIndirect = numIndirect / size + !!(numIndirect % size);
+    FreeIndex(); // the header may be reused for another file
+    kernel->synchDisk->ReadSector(sector, (char *)buf);
 
-        table = new TripleIndirect[numTripleIndirect];
-        for (int i = 0; i < numTripleIndirect; i++)
+    extentFormat = (buf[0] == ExtentMagic);
+    if (extentFormat)
+    {
+        numBytes = buf[1];
+        numSectors = buf[2];
+        if (numSectors == 0)
+        {
+            numExtents = 0;
+            overflowSector = -1;
+            memcpy(inlineData, buf + 3, MaxInlineBytes);
+        }
+        else
         {
-            table[i].FetchFrom(tripleIndirectSectors[i]);
+            numExtents = buf[3];
+            overflowSector = buf[4];
+
+            Extent *inlineExtents = (Extent *)(buf + 5);
+            extents.assign(inlineExtents, inlineExtents + min(numExtents, NumInlineExtents));
         }
     }
-    /*
-		MP4 Hint:
-		After you add some in-core informations, you will need to rebuild the header's structure
-	*/
+    else
+        memcpy((char *)this, buf, SectorSize);
 }
 
 //----------------------------------------------------------------------
@@ -199,9 +438,45 @@ void FileHeader::FetchFrom(int sector)
 
 void FileHeader::WriteBack(int sector)
 {
+    if (extentFormat)
+    {
+        int buf[PointersPerIndex];
+        int numInline = min(numExtents, NumInlineExtents);
+
+        LoadExtents();
+        memset(buf, -1, sizeof(buf));
+        buf[0] = ExtentMagic;
+        buf[1] = numBytes;
+        buf[2] = numSectors;
+        if (IsInline())
+        {
+            memcpy(buf + 3, inlineData, MaxInlineBytes);
+            kernel->synchDisk->WriteSector(sector, (char *)buf);
+            return;
+        }
+        buf[3] = numExtents;
+        buf[4] = overflowSector;
+        if (numInline > 0)
+            memcpy(buf + 5, &extents[0], numInline * sizeof(Extent));
+        kernel->synchDisk->WriteSector(sector, (char *)buf);
+
+        for (int i = 0; i < (int)overflowSectors.size(); i++)
+        {
+            int first = NumInlineExtents + i * ExtentsPerBlock;
+            int count = min(numExtents - first, ExtentsPerBlock);
+
+            memset(buf, -1, sizeof(buf));
+            buf[0] = (i + 1 < (int)overflowSectors.size()) ? overflowSectors[i + 1] : -1;
+            buf[1] = count;
+            memcpy(buf + 2, &extents[first], count * sizeof(Extent));
+            kernel->synchDisk->WriteSector(overflowSectors[i], (char *)buf);
+        }
+        return;
+    }
+
     kernel->synchDisk->WriteSector(sector, (char *)this);
     // cout << NumDirect << endl;
-    if (numSectors > NumDirect)
+    if (numSectors > NumDirect && table != NULL)
     {
         // numIndirect = numSectors - NumDirect;
         // size = SectorSize / sizeof(int); // sectors per singleIndirect
@@ -229,13 +504,52 @@ void FileHeader::WriteBack(int sector)
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	For an extent format header we scan the extent list, starting from
+//	where the previous lookup left off.  Beyond the direct blocks of an
+//	old format header we walk the triple indirect tree, one cached
+//	index block per level.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
 int FileHeader::ByteToSector(int offset)
 {
-    if (offset / SectorSize < NumDirect)
+    ASSERT(!IsInline()); // inline files have no data sectors
+    if (extentFormat)
+    {
+        int target = offset / SectorSize;
+
+        if (target < hintBase)
+        {
+            hintExtent = 0; // start over from the beginning of the file
+            hintBase = 0;
+        }
+        for (;;)
+        {
+            if (hintExtent == (int)extents.size())
+                LoadExtents();
+            ASSERT(hintExtent < (int)extents.size());
+            if (target < hintBase + extents[hintExtent].length)
+                return extents[hintExtent].start + (target - hintBase);
+            hintBase += extents[hintExtent].length;
+            hintExtent++;
+        }
+    }
+    else if (offset / SectorSize < NumDirect)
         return (dataSectors[offset / SectorSize]);
+    else if (table == NULL)
+    {
+        int target = offset / SectorSize - NumDirect;
+        int perDouble = PointersPerIndex * PointersPerIndex;
+        int perTriple = perDouble * PointersPerIndex;
+
+        int *tripleBlock = IndexBlock(tripleIndirectSectors[target / perTriple]);
+        target %= perTriple;
+        int *doubleBlock = IndexBlock(tripleBlock[target / perDouble]);
+        target %= perDouble;
+        int *singleBlock = IndexBlock(doubleBlock[target / PointersPerIndex]);
+        return singleBlock[target % PointersPerIndex];
+    }
     else
     {
         int target_Sector = offset / SectorSize - NumDirect;
@@ -247,6 +561,74 @@ int FileHeader::ByteToSector(int offset)
     }
 }
 
+//----------------------------------------------------------------------
+// FileHeader::ByteRangeToSectors
+// 	Return the disk sectors holding the bytes [offset, offset+numBytes)
+//	of the file, as runs of physically consecutive sectors, in file
+//	order.  Callers can then transfer each run as a unit, and the index
+//	is looked at once per run rather than once per sector.
+//
+//	For an extent format header the runs are just the overlapping parts
+//	of the extents.  For an old format header we look up each sector,
+//	which is cheap once its index blocks are cached, and merge sectors
+//	that turn out to be consecutive.
+//
+//	"offset" is the location within the file of the first byte
+//	"numBytes" is the number of bytes in the range
+//----------------------------------------------------------------------
+
+vector<Extent> FileHeader::ByteRangeToSectors(int offset, int numBytes)
+{
+    vector<Extent> runs;
+    int first = offset / SectorSize;
+    int last = (offset + numBytes - 1) / SectorSize;
+
+    if (numBytes <= 0)
+        return runs;
+
+    if (extentFormat)
+    {
+        ByteToSector(offset); // find the extent holding the first sector
+        for (int sector = first; sector <= last;)
+        {
+            Extent run;
+            int end = hintBase + extents[hintExtent].length;
+
+            run.start = extents[hintExtent].start + (sector - hintBase);
+            run.length = min(last + 1, end) - sector;
+            runs.push_back(run);
+            sector += run.length;
+            if (sector <= last)
+            {
+                // the range carries on into the next extent
+                hintBase = end;
+                hintExtent++;
+                if (hintExtent == (int)extents.size())
+                    LoadExtents();
+                ASSERT(hintExtent < (int)extents.size());
+            }
+        }
+    }
+    else
+    {
+        for (int i = first; i <= last; i++)
+        {
+            int sector = ByteToSector(i * SectorSize);
+
+            if (!runs.empty() && runs.back().start + runs.back().length == sector)
+                runs.back().length++;
+            else
+            {
+                Extent run;
+                run.start = sector;
+                run.length = 1;
+                runs.push_back(run);
+            }
+        }
+    }
+    return runs;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::FileLength
 // 	Return the number of bytes in the file.
@@ -257,6 +639,40 @@ int FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::IsInline
+// 	Return TRUE if the file is small enough that its data lives in
+//	the header sector instead of in data sectors of its own.
+//----------------------------------------------------------------------
+
+bool FileHeader::IsInline()
+{
+    return extentFormat && numSectors == 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ReadInline/WriteInline
+// 	Copy bytes out of, or into, the data of an inline file.  The
+//	request must lie within the file.
+//
+//	"into" -- the buffer to contain the data
+//	"from" -- the buffer containing the data to be written
+//	"numBytes" -- the number of bytes to transfer
+//	"position" -- the offset within the file of the first byte
+//----------------------------------------------------------------------
+
+void FileHeader::ReadInline(char *into, int numBytes, int position)
+{
+    ASSERT(IsInline() && position >= 0 && position + numBytes <= this->numBytes);
+    memcpy(into, inlineData + position, numBytes);
+}
+
+void FileHeader::WriteInline(char *from, int numBytes, int position)
+{
+    ASSERT(IsInline() && position >= 0 && position + numBytes <= this->numBytes);
+    memcpy(inlineData + position, from, numBytes);
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -266,15 +682,21 @@ int FileHeader::FileLength()
 void FileHeader::Print()
 {
     int i, j, k;
+    int numBlocks = IsInline() ? 1 : numSectors;
     char *data = new char[SectorSize];
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
+    if (IsInline())
+        printf("(inline)");
     for (i = 0; i < numSectors; i++)
-        printf("%d ", dataSectors[i]);
+        printf("%d ", ByteToSector(i * SectorSize));
     printf("\nFile contents:\n");
-    for (i = k = 0; i < numSectors; i++)
+    for (i = k = 0; i < numBlocks; i++)
     {
-        kernel->synchDisk->ReadSector(dataSectors[i], data);
+        if (IsInline())
+            memcpy(data, inlineData, MaxInlineBytes);
+        else
+            kernel->synchDisk->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++)
         {
             if ('\040' <= data[j] && data[j] <= '\176') // isprint(data[j])
@@ -17,15 +17,53 @@
 #include "disk.h"
 #include "pbitmap.h"
 #include "tripleindirect.h"
+#include <vector>
 
 #define TripleIndirectNum 16
 #define NumDirect (((SectorSize - 2 * sizeof(int)) / sizeof(int)) - TripleIndirectNum)
 #define MaxFileSize (NumDirect * SectorSize)
+#define PointersPerIndex (SectorSize / sizeof(int)) // sector numbers in an index block
+#define NumCachedIndex 8                             // index blocks an open file
+                                                     //  keeps in memory
+
+// Headers written by this file system describe a file as a list of
+// extents instead of one pointer per sector.  On disk such a header
+// looks like
+//
+//	ExtentMagic, numBytes, numSectors, numExtents, overflow sector,
+//	NumInlineExtents (start, length) pairs, one unused word
+//
+// and the extents that do not fit are kept in a chain of overflow
+// blocks, each holding
+//
+//	next overflow sector (or -1), number of extents, ExtentsPerBlock pairs
+//
+// A header in the original format starts with the file length, which
+// is never negative, so ExtentMagic tells the two apart.
+//
+// Files of at most MaxInlineBytes have no data sectors at all: their
+// contents are kept in the header sector, right after numSectors.
+
+#define ExtentMagic ((int)0xE47E0001)
+#define NumInlineExtents 13
+#define ExtentsPerBlock 15
+#define MaxInlineBytes (SectorSize - 3 * (int)sizeof(int))
+
+// A run of "length" consecutive disk sectors, starting at "start",
+// holding consecutive blocks of a file.
+
+class Extent
+{
+public:
+    int start;
+    int length;
+};
 
 // The following class defines the Nachos "file header" (in UNIX terms,
 // the "i-node"), describing where on disk to find all of the data in the file.
 // The file header is organized as a simple table of pointers to
-// data blocks.
+// data blocks, or, for files created on a disk formatted with extent
+// headers, as a list of runs of contiguous data blocks.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
@@ -44,9 +82,13 @@ public:
     FileHeader(); // dummy constructor to keep valgrind happy
     ~FileHeader();
 
-    bool Allocate(PersistentBitmap *bitMap, int fileSize); // Initialize a file header,
-                                                           //  including allocating space
-                                                           //  on disk for the file data
+    bool Allocate(PersistentBitmap *bitMap, int fileSize, int goal = 0); // Initialize a file header,
+                                                                         //  including allocating space
+                                                                         //  on disk for the file data,
+                                                                         //  as near "goal" as possible
+    bool Extend(PersistentBitmap *bitMap, int newSize, int goal); // Grow the file to "newSize"
+                                                                  //  bytes, allocating any
+                                                                  //  sectors it now needs
     void Deallocate(PersistentBitmap *bitMap);             // De-allocate this file's
                                                            //  data blocks
 
@@ -57,10 +99,20 @@ public:
     int ByteToSector(int offset); // Convert a byte offset into the file
                                   // to the disk sector containing
                                   // the byte
+    vector<Extent> ByteRangeToSectors(int offset, int numBytes);
+                                  // Convert a range of bytes into the
+                                  // runs of consecutive sectors holding
+                                  // them, in file order
 
     int FileLength(); // Return the length of the file
                       // in bytes
 
+    bool IsInline(); // Is the file data kept in the header sector?
+    void ReadInline(char *into, int numBytes, int position);
+    void WriteInline(char *from, int numBytes, int position);
+                     // Copy data out of/into an inline file; the
+                     //  caller writes the header back afterwards
+
     void Print(); // Print the contents of the file.
 
 private:
@@ -75,8 +127,14 @@ private:
 		
 		Disk Part - numBytes, numSectors, dataSectors occupy exactly 128 bytes and will be
 		written to a sector on disk.
-		In-core part - none
-		
+		In-core part - the index tree built by Allocate, and a small cache
+		of index blocks faulted in by ByteToSector.  Opening a file reads
+		only the header sector; the indirect blocks are read when (and if)
+		they are needed.
+
+		Headers in the extent format are decoded into numBytes,
+		numSectors and the extent list below when they are read, and
+		encoded again when they are written.
 	*/
 
     int numBytes;               // Number of bytes in the file
@@ -85,10 +143,35 @@ private:
                                 // block in the file
     int tripleIndirectSectors[TripleIndirectNum];
 
-    TripleIndirect *table;
+    TripleIndirect *table; // whole index tree, only present after
+                           //  Allocate or LoadIndex, NULL otherwise
     int numIndirect;
     int numTripleIndirect;
     int size; // sectors per singleIndirect
+
+    int *indexCache;                  // NumCachedIndex index blocks, or NULL
+                                      //  until the first indirect lookup
+    int cachedSector[NumCachedIndex]; // sector held by each slot, -1 if empty
+    int lastUsed[NumCachedIndex];     // when each slot was last looked at
+    int useClock;
+
+    bool extentFormat;           // header is stored as extents
+    vector<Extent> extents;      // extents of the file, in file order; only
+                                 //  the inline ones until LoadExtents
+    int numExtents;              // number of extents in the whole file
+    int overflowSector;          // first overflow block, or -1
+    vector<int> overflowSectors; // every overflow block, once loaded
+    int hintExtent;              // extent the last lookup ended in,
+    int hintBase;                //  and the file sector it starts at
+    char inlineData[MaxInlineBytes]; // contents of an inline file
+
+    int *IndexBlock(int sector); // Return the contents of an index block,
+                                 //  reading it through the cache
+    void LoadIndex();            // Read in the whole index tree
+    void LoadExtents();          // Read in the overflow extent blocks
+    void FreeIndex();            // Drop all in-core index state
+    bool ToExtents();            // Turn an old format header with
+                                 //  only direct blocks into extents
 };
 
 #endif // FILEHDR_H
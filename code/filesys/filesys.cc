@@ -21,12 +21,30 @@
 //	The file system assumes that the bitmap and directory files are
 //	kept "open" continuously while Nachos is running.
 //
+//	The bitmap is read in once, the first time an operation needs it,
+//	and stays in memory after that, managed by a FreeMap (freemap.h).
+//
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written back before the operation returns (the two files are
+//	kept open during all this time).  The directory is written
+//	directly; the bitmap is only written by WriteChanges, and then
+//	only the sectors of it that changed.  If the operation fails, and
+//	we have modified part of the directory, we simply discard the
+//	changed version, without writing it back to disk; sectors taken
+//	from the bitmap are given back.
+//
+//	Each such operation is a transaction of the disk's journal (see
+//	journal.h), so what it writes is logged, and committed along with
+//	other operations close to it in time; Sync commits at once.  A
+//	disk formatted without a journal is written in place.
+//
+//	Names are looked up through the kernel's dentry cache (see
+//	dentrycache.h), which every operation that adds or removes a name
+//	keeps up to date, so that walking a path that was walked recently
+//	reads no directories.  A directory can also be opened once with
+//	OpenDir, and names in it then created, opened and removed with
+//	CreateAt, OpenAt and RemoveAt, without walking its path at all.
 //
 // 	Our implementation at this point has the following restrictions:
 //
@@ -35,9 +53,9 @@
 //	   files cannot be bigger than about 3KB in size
 //	   there is no hierarchical directory structure, and only a limited
 //	     number of files can be added to the system
-//	   there is no attempt to make the system robust to failures
-//	    (if Nachos exits in the middle of an operation that modifies
-//	    the file system, it may corrupt the disk)
+//	   on a disk without a journal, there is no attempt to make the
+//	    system robust to failures (if Nachos exits in the middle of an
+//	    operation that modifies the file system, it may corrupt the disk)
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation
@@ -49,8 +67,13 @@
 #include "disk.h"
 #include "pbitmap.h"
 #include "directory.h"
+#include "dentrycache.h"
 #include "filehdr.h"
 #include "filesys.h"
+#include "freemap.h"
+#include "inodecache.h"
+#include "journal.h"
+#include "main.h"
 #include <vector>
 
 // Sectors containing the file headers for the bitmap of free sectors,
@@ -59,11 +82,14 @@
 #define FreeMapSector 0
 #define DirectorySector 1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directory; a directory starts
+// out as a header and one bucket, and grows from there.
 #define FreeMapFileSize (NumSectors / BitsInByte)
-#define DirectoryFileSize (sizeof(DirectoryEntry) * NumDirEntries)
+#define InitialDirectorySize ((1 + DirBlockSectors) * SectorSize)
+
+// Room in the journal's log kept for what an update writes besides the
+// data sectors it allocates: the file header, the directory, and so on.
+#define UpdateSlack 64
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -85,9 +111,10 @@ FileSystem::FileSystem(bool format)
     {
         cout << "FreeMapFileSize : " << 65536 << endl;
         // cout << "FreeMapFileSize : " << FreeMapFileSize << endl;
-        cout << "DirectoryFileSize : " << DirectoryFileSize + 4 << endl;
-        PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
+        cout << "DirectoryFileSize : " << 1540 << endl;
+        // cout << "DirectoryFileSize : " << InitialDirectorySize + 4 << endl;
+        freeMap = new FreeMap(NumSectors);
+        Directory *directory = new Directory;
         FileHeader *mapHdr = new FileHeader;
         FileHeader *dirHdr = new FileHeader;
 
@@ -97,12 +124,14 @@ FileSystem::FileSystem(bool format)
         // (make sure no one else grabs these!)
         freeMap->Mark(FreeMapSector);
         freeMap->Mark(DirectorySector);
+        for (int i = JournalStart; i < JournalStart + JournalSectors; i++)
+            freeMap->Mark(i);
 
         // Second, allocate space for the data blocks containing the contents
         // of the directory and bitmap files.  There better be enough space!
 
         ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
-        ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+        ASSERT(dirHdr->Allocate(freeMap, InitialDirectorySize));
 
         // Flush the bitmap and directory FileHeaders back to disk
         // We need to do this before we can "Open" the file, since open
@@ -127,7 +156,8 @@ FileSystem::FileSystem(bool format)
         // to hold the file data for the directory and bitmap.
 
         DEBUG(dbgFile, "Writing bitmap and directory back to disk.");
-        freeMap->WriteBack(freeMapFile); // flush changes to disk
+        freeMap->Attach(freeMapFile);
+        freeMap->Sync(); // flush changes to disk
         directory->WriteBack(directoryFile);
 
         if (debug->IsEnabled('f'))
@@ -135,39 +165,189 @@ FileSystem::FileSystem(bool format)
             freeMap->Print();
             directory->Print();
         }
-        delete freeMap;
         delete directory;
         delete mapHdr;
         delete dirHdr;
+
+        // From now on, metadata is logged before it goes home
+        journal = Journal::Create();
     }
     else
     {
-        // if we are not formatting the disk, just open the files representing
-        // the bitmap and directory; these are left open while Nachos is running
+        // if we are not formatting the disk, bring the disk up to date
+        // from the journal, if it has one, before reading anything else.
+        // Then just open the files representing the bitmap and directory;
+        // these are left open while Nachos is running
+        journal = Journal::Open();
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        freeMap = NULL; // read in when first needed
     }
 
-    currentDirectoryFile = directoryFile;
-    currentDirectory = new Directory(NumDirEntries);
-    currentDirectory->FetchFrom(currentDirectoryFile);
+    currentDirectoryFile = NULL;
+    currentDirectorySector = DirectorySector;
+    currentDirectory = NULL; // read in when first needed
 }
 
 //----------------------------------------------------------------------
 // MP4 mod tag
 // FileSystem::~FileSystem
+// 	Close the file system.  Nachos is halting, and everything was
+//	synced before the halt began (see Kernel::SyncBeforeHalt), so the
+//	files closed here have nothing left to write.  The journal goes
+//	last all the same: were anything written while closing them, it
+//	would still be logged, and lost as in a crash, rather than go
+//	straight home and be overwritten by an older image when the log
+//	is replayed.
 //----------------------------------------------------------------------
 FileSystem::~FileSystem()
 {
+    delete freeMap;
     delete freeMapFile;
-    if (directoryFile == currentDirectoryFile)
-        delete directoryFile;
-    else
-    {
-        delete directoryFile;
+    if (currentDirectoryFile != directoryFile)
         delete currentDirectoryFile;
-    }
+    delete directoryFile;
     delete currentDirectory;
+    delete journal;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LoadFreeMap
+// 	Read the bitmap of free sectors in from freeMapFile, the first
+//	time an operation needs it.  Operations that only read the file
+//	system never pay for reading the bitmap.
+//----------------------------------------------------------------------
+
+void FileSystem::LoadFreeMap()
+{
+    if (freeMap == NULL)
+        freeMap = new FreeMap(freeMapFile, NumSectors);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Sync
+// 	Write everything the file system is holding in memory, that has
+//	changed, back to disk, and commit the journal, so that it is all
+//	there for good.
+//----------------------------------------------------------------------
+
+void FileSystem::Sync()
+{
+    DEBUG(dbgFile, "Syncing the file system.");
+    BeginUpdate();
+    WriteChanges();
+    EndUpdate();
+    if (journal != NULL)
+        journal->Commit();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::WriteChanges
+// 	Write everything the file system is holding in memory, that has
+//	changed, back to disk, or to the journal.  Every operation that
+//	changes the file system calls this before it returns.
+//----------------------------------------------------------------------
+
+void FileSystem::WriteChanges()
+{
+    kernel->inodeCache->Sync();
+    if (freeMap != NULL)
+        freeMap->Sync();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::BeginUpdate/EndUpdate
+// 	Start and end a transaction, around an operation that changes the
+//	file system.  Without a journal, they do nothing.
+//----------------------------------------------------------------------
+
+void FileSystem::BeginUpdate()
+{
+    if (journal != NULL)
+        journal->Begin();
+}
+
+void FileSystem::EndUpdate()
+{
+    if (journal != NULL)
+        journal->End();
+}
+
+//----------------------------------------------------------------------
+// FileSystem::ExtendFile
+// 	Grow a file, allocating any data sectors it now needs from the
+//	free map, and write the changes back.  Return FALSE if the file
+//	cannot grow, either because the disk is full or because its header
+//	is in the old format, and has indirect blocks.
+//
+//	The file grows in steps, each a transaction of its own, no bigger
+//	than AllocationLimit allows, so a large extension on a fragmented
+//	disk never needs more log than the journal has.  If the running
+//	group has left no room for a step, we commit it, and try again.
+//	Inside another transaction we cannot commit, so the rest of the
+//	file is then allocated in one step; Commit copes with a group that
+//	outgrows the log.  If it fails part way, because the disk is full,
+//	the file keeps the steps that were done.
+//
+//	"hdr" is the cached header of the file
+//	"sector" is the disk sector holding the header
+//	"newSize" is the new length of the file, in bytes
+//----------------------------------------------------------------------
+
+bool FileSystem::ExtendFile(FileHeader *hdr, int sector, int newSize)
+{
+    bool success = TRUE;
+    int size, limit;
+
+    LoadFreeMap();
+    while (success && hdr->FileLength() < newSize)
+    {
+        BeginUpdate();
+        limit = AllocationLimit();
+        if (limit == 0 && journal->Outermost())
+        {
+            EndUpdate();
+            journal->Commit(); // make room in the log, then retry
+            continue;
+        }
+        if (limit == 0)
+            limit = NumSectors;
+        size = (divRoundUp(hdr->FileLength(), SectorSize) + limit) * SectorSize;
+        size = min(size, newSize);
+        success = hdr->Extend(freeMap, size, sector + 1);
+        if (success)
+        {
+            kernel->inodeCache->MarkDirty(hdr);
+            WriteChanges();
+        }
+        EndUpdate();
+    }
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::AllocationLimit
+// 	Return how many data sectors the running transaction may allocate,
+//	and still be sure that everything it writes fits in the journal's
+//	log.  On a fragmented disk, each sector allocated may change a
+//	different sector of the free map, and need an extent of its own,
+//	ExtentsPerBlock of which fill an overflow block of the header.
+//	Without a journal, there is no limit.
+//----------------------------------------------------------------------
+
+int FileSystem::AllocationLimit()
+{
+    int freeMapSectors = divRoundUp(FreeMapFileSize, SectorSize);
+    int room;
+
+    if (journal == NULL)
+        return NumSectors;
+    room = journal->Room() - UpdateSlack;
+    if (room <= 0)
+        return 0;
+    if (room * ExtentsPerBlock / (ExtentsPerBlock + 1) <= freeMapSectors)
+        return room * ExtentsPerBlock / (ExtentsPerBlock + 1);
+    return (room - freeMapSectors) * ExtentsPerBlock;
 }
 
 vector<string> FileSystem::path_Parser(char *name)
@@ -197,6 +377,98 @@ vector<string> FileSystem::path_Parser(char *name)
     return path_name;
 }
 
+//----------------------------------------------------------------------
+// FileSystem::SetCurrentDir
+// 	Make the directory whose header is at "sector" the current one,
+//	closing the one before.  It is not read in until it is needed.
+//----------------------------------------------------------------------
+
+void FileSystem::SetCurrentDir(int sector)
+{
+    if (currentDirectoryFile != directoryFile)
+        delete currentDirectoryFile;
+    delete currentDirectory;
+    currentDirectoryFile = NULL;
+    currentDirectory = NULL;
+    currentDirectorySector = sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CurrentDirectory
+// 	Return the current directory, opening it and reading it in if
+//	that has not been done yet.
+//----------------------------------------------------------------------
+
+Directory *FileSystem::CurrentDirectory()
+{
+    if (currentDirectory == NULL)
+    {
+        if (currentDirectorySector == DirectorySector)
+            currentDirectoryFile = directoryFile;
+        else
+            currentDirectoryFile = new OpenFile(currentDirectorySector);
+        currentDirectory = new Directory;
+        currentDirectory->FetchFrom(currentDirectoryFile);
+    }
+    return currentDirectory;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LookUp
+// 	Look up "name" in the current directory, and return the sector of
+//	its header, or -1 if there is no such name.  The dentry cache is
+//	asked first; only if it does not know is the directory read, and
+//	what was found (or not found) is then remembered there.
+//
+//	"name" -- the name to look up
+//	"type" -- where to return FILE_TYPE or DIRECTORY_TYPE; may be NULL
+//----------------------------------------------------------------------
+
+int FileSystem::LookUp(char *name, int *type)
+{
+    int sector, found;
+
+    if (kernel->dentryCache->Lookup(currentDirectorySector, name, &sector, type))
+        return sector;
+    sector = CurrentDirectory()->Find(name, &found);
+    Remember(name, sector, found);
+    if (type != NULL)
+        *type = found;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Remember
+// 	Record in the dentry cache what "name" in the current directory
+//	refers to.  A directory keeps only the first MaxNameLength
+//	characters of a name, so a longer name stands for every name that
+//	starts the same way; rather than track those, we drop whatever is
+//	cached for the directory.
+//
+//	"sector" -- the sector of the header it names, or -1 if none
+//	"type" -- FILE_TYPE or DIRECTORY_TYPE
+//----------------------------------------------------------------------
+
+void FileSystem::Remember(char *name, int sector, int type)
+{
+    if ((int)strlen(name) > CurrentDirectory()->MaxNameLength())
+        kernel->dentryCache->ForgetDirectory(currentDirectorySector);
+    else
+        kernel->dentryCache->Enter(currentDirectorySector, name, sector, type);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::changeCurrenDir
+// 	Walk an absolute path from the root, making each directory along
+//	it the current one in turn.  Each name is looked up with LookUp,
+//	so a path the dentry cache knows is walked without reading any
+//	directory.  Return FALSE, leaving the last directory reached as
+//	the current one, if some name along the path does not exist.
+//
+//	"name" -- the path
+//	"lastname" -- should the last name of the path be walked into too?
+//----------------------------------------------------------------------
+
 bool FileSystem::changeCurrenDir(char *name, bool lastname)
 {
     vector<string> path_name = path_Parser(name);
@@ -211,14 +483,13 @@ bool FileSystem::changeCurrenDir(char *name, bool lastname)
 
     if (name[0] == '/')
     {
-        //OpenFile &tempDirectoryFile = *currentDirectoryFile; // save pointer
-        currentDirectoryFile = directoryFile;
-        currentDirectory->FetchFrom(currentDirectoryFile);
+        SetCurrentDir(DirectorySector);
         for (int i = 0; i < limit && success == true; i++)
         {
             char *temp_c_str = new char[path_name[i].length() + 1];
             strcpy(temp_c_str, path_name[i].c_str());
-            sector = currentDirectory->Find(temp_c_str);
+            sector = LookUp(temp_c_str, NULL);
+            delete[] temp_c_str;
             if (sector == -1) // can't find the path
             {
                 std::cout << "No such Directory :";
@@ -229,16 +500,7 @@ bool FileSystem::changeCurrenDir(char *name, bool lastname)
                 success = false;
             }
             else
-            {
-                if (currentDirectoryFile != directoryFile)
-                {
-                    delete currentDirectoryFile;
-                    delete currentDirectory;
-                }
-                currentDirectoryFile = new OpenFile(sector);
-                currentDirectory = new Directory(NumDirEntries);
-                currentDirectory->FetchFrom(currentDirectoryFile);
-            }
+                SetCurrentDir(sector);
         }
     }
 
@@ -247,15 +509,7 @@ bool FileSystem::changeCurrenDir(char *name, bool lastname)
 
 void FileSystem::closeCurrentDir()
 {
-    if (currentDirectoryFile != directoryFile)
-    {
-        delete currentDirectoryFile;
-        delete currentDirectory;
-
-        currentDirectoryFile = directoryFile;
-        currentDirectory = new Directory(NumDirEntries);
-        currentDirectory->FetchFrom(currentDirectoryFile);
-    }
+    SetCurrentDir(DirectorySector);
 }
 
 bool FileSystem::Mkdir(char *name)
@@ -263,7 +517,6 @@ bool FileSystem::Mkdir(char *name)
     vector<string> path_name = path_Parser(name);
     Directory *newDirectory;
     OpenFile *newDirectoryFile;
-    PersistentBitmap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success = true;
@@ -284,32 +537,36 @@ bool FileSystem::Mkdir(char *name)
 
     char *temp_c_str = new char[path_name[path_name.size() - 1].length() + 1];
     strcpy(temp_c_str, path_name[path_name.size() - 1].c_str());
-    if (currentDirectory->Find(temp_c_str) != -1) //folder already exist
+    if (LookUp(temp_c_str, NULL) != -1) //folder already exist
     {
         std::cout << "Directory already existed :" << name << std::endl;
         success = false;
     }
     else
     {
-        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
-        sector = freeMap->FindAndSet(); // find a sector to hold the file header
+        LoadFreeMap();
+        BeginUpdate();
+        // find a sector to hold the file header, near its directory
+        sector = freeMap->Allocate(currentDirectorySector);
         if (sector == -1)
         {
             success = FALSE; // no free block for file header
             std::cout << "no free block for file header" << std::endl;
         }
-        else if (!currentDirectory->Add(temp_c_str, sector, DIRECTORY_TYPE))
+        else if (!CurrentDirectory()->Add(temp_c_str, sector, DIRECTORY_TYPE))
         {
             success = FALSE; // no space in directory
             std::cout << "no space in directory" << std::endl;
+            freeMap->Free(sector);
         }
         else
         {
             hdr = new FileHeader;
-            if (!hdr->Allocate(freeMap, DirectoryFileSize))
+            if (!hdr->Allocate(freeMap, InitialDirectorySize, sector + 1))
             {
                 success = FALSE; // no space on disk for data
                 std::cout << "no space on disk for data" << std::endl;
+                freeMap->Free(sector);
             }
             else
             {
@@ -317,18 +574,19 @@ bool FileSystem::Mkdir(char *name)
                 // everthing worked, flush all changes back to disk
                 hdr->WriteBack(sector);
                 currentDirectory->WriteBack(currentDirectoryFile);
-                freeMap->WriteBack(freeMapFile);
+                Remember(temp_c_str, sector, DIRECTORY_TYPE);
 
                 newDirectoryFile = new OpenFile(sector);
-                newDirectory = new Directory(NumDirEntries);
+                newDirectory = new Directory;
                 newDirectory->WriteBack(newDirectoryFile);
 
                 delete newDirectory;
                 delete newDirectoryFile;
+                WriteChanges();
             }
             delete hdr;
         }
-        delete freeMap;
+        EndUpdate();
     }
 
     delete[] temp_c_str;
@@ -369,9 +627,6 @@ bool FileSystem::Mkdir(char *name)
 bool FileSystem::Create(char *name, int initialSize)
 {
     vector<string> path_name = path_Parser(name);
-    PersistentBitmap *freeMap;
-    FileHeader *hdr;
-    int sector;
     bool success;
 
     DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
@@ -391,35 +646,78 @@ bool FileSystem::Create(char *name, int initialSize)
     char *temp_c_str = new char[path_name[path_name.size() - 1].length() + 1];
     strcpy(temp_c_str, path_name[path_name.size() - 1].c_str());
 
-    if (currentDirectory->Find(temp_c_str) != -1) // file is already in directory
+    success = CreateHere(temp_c_str, initialSize);
+    delete[] temp_c_str;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CreateHere
+// 	Create a file called "name" in the current directory; the rest of
+//	Create, once the path has been walked.
+//----------------------------------------------------------------------
+
+bool FileSystem::CreateHere(char *name, int initialSize)
+{
+    FileHeader *hdr;
+    int sector, size = initialSize;
+    bool success;
+
+    if (LookUp(name, NULL) != -1) // file is already in directory
     {
         std::cout << "File is already in directory :" << name << std::endl;
         success = FALSE;
     }
     else
     {
-        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
-        sector = freeMap->FindAndSet(); // find a sector to hold the file header
+        LoadFreeMap();
+        BeginUpdate();
+        // find a sector to hold the file header, near its directory
+        sector = freeMap->Allocate(currentDirectorySector);
         if (sector == -1)
             success = FALSE; // no free block for file header
-        else if (!currentDirectory->Add(temp_c_str, sector, FILE_TYPE))
+        else if (!CurrentDirectory()->Add(name, sector, FILE_TYPE))
+        {
             success = FALSE; // no space in directory
+            freeMap->Free(sector);
+        }
         else
         {
+            // a file too big to allocate in one transaction gets the
+            // rest of its sectors from ExtendFile, below
+            size = min(initialSize, AllocationLimit() * SectorSize);
             hdr = new FileHeader;
-            if (!hdr->Allocate(freeMap, initialSize))
+            if (size < initialSize
+                && divRoundUp(initialSize, SectorSize) > freeMap->NumFree())
+            {
                 success = FALSE; // no space on disk for data
+                freeMap->Free(sector);
+            }
+            else if (!hdr->Allocate(freeMap, size, sector + 1))
+            {
+                success = FALSE; // no space on disk for data
+                freeMap->Free(sector);
+            }
             else
             {
                 success = TRUE;
                 // everthing worked, flush all changes back to disk
                 hdr->WriteBack(sector);
                 currentDirectory->WriteBack(currentDirectoryFile);
-                freeMap->WriteBack(freeMapFile);
+                Remember(name, sector, FILE_TYPE);
+                WriteChanges();
             }
             delete hdr;
         }
-        delete freeMap;
+        EndUpdate();
+    }
+    if (success && size < initialSize)
+    {
+        hdr = kernel->inodeCache->Acquire(sector);
+        success = ExtendFile(hdr, sector, initialSize);
+        kernel->inodeCache->Release(hdr);
+        if (!success)
+            RemoveHere(name); // give back what was allocated
     }
     return success;
 }
@@ -437,8 +735,7 @@ bool FileSystem::Create(char *name, int initialSize)
 OpenFile *FileSystem::Open(char *name)
 {
     vector<string> path_name = path_Parser(name);
-    OpenFile *openFile = NULL;
-    int sector;
+    OpenFile *openFile;
 
     changeCurrenDir(name, false);
 
@@ -446,14 +743,31 @@ OpenFile *FileSystem::Open(char *name)
     strcpy(temp_c_str, path_name[path_name.size() - 1].c_str());
 
     DEBUG(dbgFile, "Opening file" << name);
-    sector = currentDirectory->Find(temp_c_str);
-    if (sector >= 0)
-        openFile = new OpenFile(sector); // name was found in directory
+    openFile = OpenHere(temp_c_str, 0);
 
     delete temp_c_str;
     return openFile; // return NULL if not found
 }
 
+//----------------------------------------------------------------------
+// FileSystem::OpenHere
+// 	Open "name" in the current directory, or return NULL if there is
+//	no such name.
+//
+//	"type" -- if not 0, the name must also be of this type (FILE_TYPE
+//	    or DIRECTORY_TYPE)
+//----------------------------------------------------------------------
+
+OpenFile *FileSystem::OpenHere(char *name, int type)
+{
+    int sector, found;
+
+    sector = LookUp(name, &found);
+    if (sector < 0 || (type != 0 && found != type))
+        return NULL;
+    return new OpenFile(sector); // name was found in directory
+}
+
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
@@ -471,10 +785,7 @@ OpenFile *FileSystem::Open(char *name)
 bool FileSystem::Remove(char *name)
 {
     vector<string> path_name = path_Parser(name);
-    PersistentBitmap *freeMap;
-    FileHeader *fileHdr;
-    int sector;
-    int index_dir;
+    bool success;
 
     DEBUG(dbgFile, "Removing File : " << name);
 
@@ -493,27 +804,150 @@ bool FileSystem::Remove(char *name)
     char *temp_c_str = new char[path_name[path_name.size() - 1].length() + 1];
     strcpy(temp_c_str, path_name[path_name.size() - 1].c_str());
 
-    sector = currentDirectory->Find(temp_c_str);
+    success = RemoveHere(temp_c_str);
+    delete[] temp_c_str;
+    closeCurrentDir();
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RemoveHere
+// 	Remove "name" from the current directory; the rest of Remove, once
+//	the path has been walked.  Return FALSE if there is no such name.
+//----------------------------------------------------------------------
+
+bool FileSystem::RemoveHere(char *name)
+{
+    FileHeader *fileHdr;
+    int sector, type;
+
+    sector = LookUp(name, &type);
     if (sector == -1)
+        return FALSE; // file not found
+    fileHdr = kernel->inodeCache->Acquire(sector);
+
+    LoadFreeMap();
+    BeginUpdate();
+    fileHdr->Deallocate(freeMap); // remove data blocks
+    freeMap->Free(sector);        // remove header block
+    CurrentDirectory()->Remove(name);
+    kernel->inodeCache->Release(fileHdr);
+    kernel->inodeCache->Invalidate(sector);
+    Remember(name, -1, 0);
+    if (type == DIRECTORY_TYPE)
+        kernel->dentryCache->ForgetDirectory(sector);
+
+    currentDirectory->WriteBack(currentDirectoryFile); // flush to disk
+    WriteChanges();
+    EndUpdate();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenDir
+// 	Open the directory at "path", and return it, to be handed to
+//	CreateAt, OpenAt and RemoveAt; delete it to close it.  Return NULL
+//	if there is no such directory.
+//
+//	The path is walked once, here; an operation on a name in an open
+//	directory starts from the directory itself, so what it costs does
+//	not depend on how deep the directory is.
+//
+//	"path" -- the absolute path of the directory
+//----------------------------------------------------------------------
+
+OpenFile *FileSystem::OpenDir(char *path)
+{
+    vector<string> path_name = path_Parser(path);
+    OpenFile *openFile = NULL;
+
+    DEBUG(dbgFile, "Opening directory " << path);
+
+    if (path_name.size() <= 0)
+        openFile = new OpenFile(DirectorySector); // the root
+    else
     {
+        if (changeCurrenDir(path, false))
+        {
+            char *temp_c_str = new char[path_name[path_name.size() - 1].length() + 1];
+            strcpy(temp_c_str, path_name[path_name.size() - 1].c_str());
+            openFile = OpenHere(temp_c_str, DIRECTORY_TYPE);
+            delete[] temp_c_str;
+        }
         closeCurrentDir();
-        return FALSE; // file not found
     }
-    fileHdr = new FileHeader;
-    fileHdr->FetchFrom(sector);
+    if (openFile != NULL)
+        openFile->MarkDirectory();
+    return openFile;
+}
 
-    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+//----------------------------------------------------------------------
+// FileSystem::EnterDir
+// 	Make the open directory "dir" the current one, for an operation on
+//	"name" in it.  Return FALSE if "name" is not a single name, or "dir"
+//	is not a directory handle -- one returned by OpenDir, rather than
+//	by Open or OpenAt.
+//----------------------------------------------------------------------
 
-    fileHdr->Deallocate(freeMap); // remove data blocks
-    freeMap->Clear(sector);       // remove header block
-    currentDirectory->Remove(temp_c_str);
+bool FileSystem::EnterDir(OpenFile *dir, char *name)
+{
+    if (dir == NULL || !dir->IsDirectory() || name[0] == '\0' ||
+        strchr(name, '/') != NULL)
+        return FALSE;
+    SetCurrentDir(dir->HeaderSector());
+    return TRUE;
+}
 
-    freeMap->WriteBack(freeMapFile);                   // flush to disk
-    currentDirectory->WriteBack(currentDirectoryFile); // flush to disk
-    delete fileHdr;
-    delete freeMap;
+//----------------------------------------------------------------------
+// FileSystem::CreateAt
+// 	Create a file called "name" in the open directory "dir"; otherwise
+//	like Create.
+//----------------------------------------------------------------------
+
+bool FileSystem::CreateAt(OpenFile *dir, char *name, int initialSize)
+{
+    bool success;
+
+    DEBUG(dbgFile, "Creating file " << name << " size " << initialSize);
+    if (!EnterDir(dir, name))
+        return FALSE;
+    success = CreateHere(name, initialSize);
     closeCurrentDir();
-    return TRUE;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenAt
+// 	Open "name" in the open directory "dir"; otherwise like Open.
+//----------------------------------------------------------------------
+
+OpenFile *FileSystem::OpenAt(OpenFile *dir, char *name)
+{
+    OpenFile *openFile;
+
+    DEBUG(dbgFile, "Opening file " << name);
+    if (!EnterDir(dir, name))
+        return NULL;
+    openFile = OpenHere(name, 0);
+    closeCurrentDir();
+    return openFile;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::RemoveAt
+// 	Remove "name" from the open directory "dir"; otherwise like Remove.
+//----------------------------------------------------------------------
+
+bool FileSystem::RemoveAt(OpenFile *dir, char *name)
+{
+    bool success;
+
+    DEBUG(dbgFile, "Removing File : " << name);
+    if (!EnterDir(dir, name))
+        return FALSE;
+    success = RemoveHere(name);
+    closeCurrentDir();
+    return success;
 }
 
 //----------------------------------------------------------------------
@@ -524,14 +958,14 @@ bool FileSystem::Remove(char *name)
 void FileSystem::List(char *path)
 {
     changeCurrenDir(path, true);
-    currentDirectory->List(false);
+    CurrentDirectory()->List(false);
 
     closeCurrentDir();
 }
 
 void FileSystem::ListRecur(char *path)
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory;
 
     directory->FetchFrom(directoryFile);
     directory->List(true);
@@ -552,8 +986,7 @@ void FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile, NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory;
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -563,6 +996,7 @@ void FileSystem::Print()
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
 
+    LoadFreeMap();
     freeMap->Print();
 
     directory->FetchFrom(directoryFile);
@@ -570,7 +1004,6 @@ void FileSystem::Print()
 
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 }
 
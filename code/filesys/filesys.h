@@ -38,8 +38,12 @@
 #include "openfile.h"
 #include "directory.h"
 #include "pbitmap.h"
+#include "freemap.h"
+#include "journal.h"
 #include <vector>
 
+class FileHeader;
+
 #ifdef FILESYS_STUB // Temporarily implement file system calls as
 // calls to UNIX, until the real file system
 // implementation is available
@@ -112,18 +116,63 @@ public:
 
     bool Remove(char *name); // Delete a file (UNIX unlink)
 
+    OpenFile *OpenDir(char *path); // Open a directory, for the
+                                   //  calls below (UNIX opendir)
+    bool CreateAt(OpenFile *dir, char *name, int initialSize);
+    // Create, Open and Remove a file
+    OpenFile *OpenAt(OpenFile *dir, char *name);
+    //  in an open directory (UNIX
+    bool RemoveAt(OpenFile *dir, char *name);
+    //  openat, unlinkat)
+
     void List(char *path); // List all the files in the file system
 
     void Print(); // List all the files and their contents
 
+    void Sync(); // Write changed file system state held
+                 // in memory back to disk, and commit
+                 // the journal
+
+    bool ExtendFile(FileHeader *hdr, int sector, int newSize);
+    // Grow an open file whose header
+    // is at "sector" to "newSize" bytes
+
 private:
     OpenFile *freeMapFile;   // Bit map of free disk blocks,
                              // represented as a file
+    FreeMap *freeMap;        // The contents of freeMapFile, kept in
+                             // memory once it has been read in
     OpenFile *directoryFile; // "Root" directory -- list of
                              // file names, represented as a file
     OpenFile *currentDirectoryFile;
-
-    Directory *currentDirectory;
+    int currentDirectorySector; // Header sector of currentDirectoryFile
+
+    Directory *currentDirectory; // NULL until it is needed
+    Journal *journal; // Where metadata updates are logged;
+                      // NULL if the disk has no journal
+
+    void LoadFreeMap(); // Read in freeMap, if we haven't yet
+    void SetCurrentDir(int sector); // Change the current directory
+    Directory *CurrentDirectory();  // Read it in, if we haven't yet
+    int LookUp(char *name, int *type);
+    // Header sector of "name" in the
+    //  current directory, via the
+    //  dentry cache
+    void Remember(char *name, int sector, int type);
+    // Cache what "name" in the current
+    //  directory names
+    bool CreateHere(char *name, int initialSize);
+    // Create, Open and Remove "name"
+    OpenFile *OpenHere(char *name, int type);
+    //  in the current directory
+    bool RemoveHere(char *name);
+    bool EnterDir(OpenFile *dir, char *name);
+    int AllocationLimit(); // Data sectors a transaction may
+                           //  still allocate
+    // Make "dir" the current directory
+    void BeginUpdate(); // Start a transaction, if there is
+    void EndUpdate();   // a journal; end it
+    void WriteChanges(); // Write changed state held in memory
 };
 
 #endif // FILESYS
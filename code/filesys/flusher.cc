@@ -0,0 +1,101 @@
+// flusher.cc
+//	Routines for the background flusher thread.
+//
+//	See flusher.h for when the flusher runs.
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "flusher.h"
+#include "synchdisk.h"
+
+// Dummy function because C++ does not allow pointers to member
+// functions to be passed to Thread::Fork.
+
+static void
+FlusherRun(Flusher *flusher)
+{
+    flusher->Run();
+}
+
+//----------------------------------------------------------------------
+// Flusher::Flusher
+// 	Fork the flusher thread.  It waits until a flush is wanted.
+//
+//	"disk" is the disk whose dirty sectors are to be flushed
+//----------------------------------------------------------------------
+
+Flusher::Flusher(SynchDisk *disk)
+{
+    Thread *thread = new Thread("flusher", -1);
+
+    this->disk = disk;
+    wakeup = new Semaphore("flusher wakeup", 0);
+    timerPending = FALSE;
+    thread->Fork((VoidFunctionPtr)FlusherRun, (void *)this);
+}
+
+//----------------------------------------------------------------------
+// Flusher::~Flusher
+// 	De-allocate the flusher.  Nachos is halting, so the thread is
+//	left where it is, asleep.
+//----------------------------------------------------------------------
+
+Flusher::~Flusher()
+{
+    delete wakeup;
+}
+
+//----------------------------------------------------------------------
+// Flusher::Schedule
+// 	Arrange for a flush FlushInterval ticks from now, unless one is
+//	already on the way.
+//----------------------------------------------------------------------
+
+void
+Flusher::Schedule()
+{
+    if (!timerPending) {
+        timerPending = TRUE;
+        kernel->interrupt->Schedule(this, FlushInterval, TimerInt);
+    }
+}
+
+//----------------------------------------------------------------------
+// Flusher::Wake
+// 	Get the flusher thread going right away.
+//----------------------------------------------------------------------
+
+void
+Flusher::Wake()
+{
+    wakeup->V();
+}
+
+//----------------------------------------------------------------------
+// Flusher::CallBack
+// 	Timer interrupt handler: it is time to flush.
+//----------------------------------------------------------------------
+
+void
+Flusher::CallBack()
+{
+    timerPending = FALSE;
+    wakeup->V();
+}
+
+//----------------------------------------------------------------------
+// Flusher::Run
+// 	Wait for a flush to be wanted, then write every dirty sector back
+//	to disk, forever.
+//----------------------------------------------------------------------
+
+void
+Flusher::Run()
+{
+    for (;;) {
+        wakeup->P();
+        DEBUG(dbgDisk, "Flusher woken at " << kernel->stats->totalTicks);
+        disk->WriteBack();
+    }
+}
@@ -0,0 +1,49 @@
+// flusher.h
+//	Data structures for writing dirty cached sectors back to disk in
+//	the background.
+//
+//	In write-back mode, SynchDisk leaves written sectors dirty in its
+//	block cache.  The flusher is a kernel thread that sleeps until
+//	there is work, then writes the dirty sectors back.  It is woken
+//	either by a timer FlushInterval ticks after a sector first became
+//	dirty, or at once when the number of dirty sectors reaches the
+//	high-water mark.
+//
+//	The timer is a one-shot interrupt, only scheduled while something
+//	is dirty.  So an idle flusher never keeps Nachos from halting, and
+//	Nachos never halts (by running out of things to do) while a sector
+//	is still waiting to be written.
+
+#ifndef FLUSHER_H
+#define FLUSHER_H
+
+#include "copyright.h"
+#include "callback.h"
+#include "synch.h"
+
+#define FlushInterval 20000 // ticks a dirty sector may wait to be written
+
+class SynchDisk;
+
+// The following class defines the background flusher.
+
+class Flusher : public CallBackObj
+{
+public:
+    Flusher(SynchDisk *disk); // Start the flusher thread for "disk"
+    ~Flusher();
+
+    void Schedule(); // Something is dirty: flush within FlushInterval
+    void Wake();     // Too much is dirty: flush now
+
+    void CallBack(); // Called when the flush timer goes off
+
+    void Run(); // Body of the flusher thread; never returns
+
+private:
+    SynchDisk *disk;      // the disk to write back
+    Semaphore *wakeup;    // V'ed whenever a flush is wanted
+    bool timerPending;    // is the flush timer already set?
+};
+
+#endif // FLUSHER_H
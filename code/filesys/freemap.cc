@@ -0,0 +1,103 @@
+// freemap.cc
+//	Routines to manage the free sectors of a mounted file system.
+//
+//	The file system reads the free map in once and keeps it; every
+//	sector it hands out or takes back goes through here, and nothing
+//	is written to disk until Sync is called.  Because the map is a
+//	PersistentBitmap, Sync only writes the sectors of the free map file
+//	that hold bits which changed.
+
+#include "copyright.h"
+#include "debug.h"
+#include "freemap.h"
+
+//----------------------------------------------------------------------
+// FreeMap::FreeMap(int)
+// 	Initialize an empty free map, with every sector free, for a disk
+//	that is being formatted.  The file the map lives in can only be
+//	opened once the map has allocated space for it, so it is given
+//	later, with Attach.
+//
+//	"numItems" is the number of sectors on the disk
+//----------------------------------------------------------------------
+
+FreeMap::FreeMap(int numItems) : PersistentBitmap(numItems)
+{
+    file = NULL;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::FreeMap(OpenFile *, int)
+// 	Read in the free map of a disk that is being mounted.
+//
+//	"file" is the free map file
+//	"numItems" is the number of sectors on the disk
+//----------------------------------------------------------------------
+
+FreeMap::FreeMap(OpenFile *file, int numItems) : PersistentBitmap(file, numItems)
+{
+    this->file = file;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::~FreeMap
+// 	The free map file belongs to the file system, so there is nothing
+//	to do here except what PersistentBitmap does.
+//----------------------------------------------------------------------
+
+FreeMap::~FreeMap()
+{
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Attach
+// 	Tell a newly formatted free map which file it is stored in.
+//----------------------------------------------------------------------
+
+void FreeMap::Attach(OpenFile *file)
+{
+    this->file = file;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Allocate
+// 	Allocate a single sector, preferring the first free sector at or
+//	after "goal", so that related blocks (a file header and the
+//	directory it is in, for instance) end up close together.
+//
+//	Return the sector number, or -1 if the disk is full.
+//----------------------------------------------------------------------
+
+int FreeMap::Allocate(int goal)
+{
+    int length;
+    int sector = AllocateRun(1, goal, &length);
+
+    DEBUG(dbgFile, "Allocated sector " << sector << " near " << goal);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Free
+// 	Return "sector" to the pool of free sectors.
+//----------------------------------------------------------------------
+
+void FreeMap::Free(int sector)
+{
+    ASSERT(Test(sector)); // ought to be marked!
+    Clear(sector);
+}
+
+//----------------------------------------------------------------------
+// FreeMap::Sync
+// 	Write the parts of the map that changed since the last Sync back
+//	to the free map file.  This is the only place the free map is
+//	written while the file system is mounted.
+//----------------------------------------------------------------------
+
+void FreeMap::Sync()
+{
+    ASSERT(file != NULL);
+    if (IsDirty())
+        WriteBack(file);
+}
@@ -0,0 +1,44 @@
+// freemap.h
+//	Data structures for managing the free sectors of the disk while
+//	the file system is mounted.
+//
+//	The free map is a persistent bitmap (see pbitmap.h), with one bit
+//	per disk sector, that stays in memory for as long as the file
+//	system is mounted.  All allocation is done against the in-memory
+//	copy; the changed parts are only written to the free map file
+//	when the file system calls Sync.
+
+#ifndef FREEMAP_H
+#define FREEMAP_H
+
+#include "copyright.h"
+#include "pbitmap.h"
+#include "openfile.h"
+
+// The following class defines the free-space manager.  It inherits the
+// behavior of a persistent bitmap, so it can be passed to the file header
+// allocation routines, and adds allocation near a goal sector and an
+// explicit sync point.
+
+class FreeMap : public PersistentBitmap
+{
+public:
+    FreeMap(int numItems);                 // An empty map, for formatting
+    FreeMap(OpenFile *file, int numItems); // Read the map from "file"
+    ~FreeMap();
+
+    void Attach(OpenFile *file); // Set the file the map is stored in
+
+    int Allocate(int goal); // Allocate one sector, as near "goal"
+                            // as possible; -1 if the disk is full
+    void Free(int sector);  // Return an allocated sector
+
+    int NumFree() const { return NumClear(); }
+
+    void Sync(); // Write the changed parts of the map to disk
+
+private:
+    OpenFile *file; // The free map file
+};
+
+#endif // FREEMAP_H
@@ -0,0 +1,212 @@
+// inodecache.cc
+//	Routines to share file headers between open files.
+//
+//	The cache is small, so entries are kept in a plain vector and found
+//	by a linear scan; that is still far cheaper than a disk read.
+
+#include "copyright.h"
+#include "debug.h"
+#include "inodecache.h"
+
+//----------------------------------------------------------------------
+// InodeCache::InodeCache
+// 	Initialize an empty inode cache.
+//
+//	"size" is the number of headers nobody has open that we keep
+//----------------------------------------------------------------------
+
+InodeCache::InodeCache(int size)
+{
+    this->size = size;
+    useClock = 0;
+}
+
+//----------------------------------------------------------------------
+// InodeCache::~InodeCache
+// 	Free every header.  Nachos is halting, and the disk can no longer
+//	be used, so nothing is written back here: changed headers were
+//	written back by the file system's Sync before the halt.
+//----------------------------------------------------------------------
+
+InodeCache::~InodeCache()
+{
+    for (int i = 0; i < (int)inodes.size(); i++)
+        delete inodes[i].hdr;
+}
+
+//----------------------------------------------------------------------
+// InodeCache::FindSector/FindHeader
+// 	Return the index of the entry for a header, by the sector it is
+//	stored in, or by its address.  Return -1 if it is not cached.
+//----------------------------------------------------------------------
+
+int InodeCache::FindSector(int sector)
+{
+    for (int i = 0; i < (int)inodes.size(); i++)
+        if (inodes[i].sector == sector)
+            return i;
+    return -1;
+}
+
+int InodeCache::FindHeader(FileHeader *hdr)
+{
+    for (int i = 0; i < (int)inodes.size(); i++)
+        if (inodes[i].hdr == hdr)
+            return i;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// InodeCache::Acquire
+// 	Return the header stored at "sector", and take a reference to it.
+//	The header is only read from disk if it is not already cached.
+//
+//	"sector" is the disk sector containing the file header
+//----------------------------------------------------------------------
+
+FileHeader *InodeCache::Acquire(int sector)
+{
+    int i = FindSector(sector);
+
+    useClock++;
+    if (i == -1)
+    {
+        CachedInode inode;
+
+        DEBUG(dbgFile, "Inode cache miss on sector " << sector);
+        inode.sector = sector;
+        inode.hdr = new FileHeader;
+        inode.hdr->FetchFrom(sector);
+        inode.refCount = 0;
+        inode.dirty = FALSE;
+        inodes.push_back(inode);
+        i = inodes.size() - 1;
+    }
+    inodes[i].refCount++;
+    inodes[i].lastUsed = useClock;
+    return inodes[i].hdr;
+}
+
+//----------------------------------------------------------------------
+// InodeCache::Release
+// 	Give back a reference to a header.  When the last reference goes
+//	away, a changed header is written back, and a removed file's
+//	header is freed; otherwise the header stays cached for next time.
+//
+//	"hdr" is the header returned by Acquire
+//----------------------------------------------------------------------
+
+void InodeCache::Release(FileHeader *hdr)
+{
+    int i = FindHeader(hdr);
+
+    ASSERT(i != -1 && inodes[i].refCount > 0);
+    if (--inodes[i].refCount > 0)
+        return;
+
+    if (inodes[i].sector == -1)
+    {
+        delete inodes[i].hdr;
+        inodes.erase(inodes.begin() + i);
+        return;
+    }
+    if (inodes[i].dirty)
+    {
+        inodes[i].hdr->WriteBack(inodes[i].sector);
+        inodes[i].dirty = FALSE;
+    }
+    Trim();
+}
+
+//----------------------------------------------------------------------
+// InodeCache::MarkDirty
+// 	Note that a header has been changed in memory, and so must be
+//	written back before it leaves the cache.
+//
+//	"hdr" is a header returned by Acquire
+//----------------------------------------------------------------------
+
+void InodeCache::MarkDirty(FileHeader *hdr)
+{
+    int i = FindHeader(hdr);
+
+    ASSERT(i != -1);
+    if (inodes[i].sector != -1)
+        inodes[i].dirty = TRUE;
+}
+
+//----------------------------------------------------------------------
+// InodeCache::Invalidate
+// 	The file whose header is at "sector" has been removed, and the
+//	sector may be reused for another header.  Drop the cached copy;
+//	if someone still has it, it is freed when they release it, and it
+//	is never written back.
+//
+//	"sector" is the disk sector that contained the file header
+//----------------------------------------------------------------------
+
+void InodeCache::Invalidate(int sector)
+{
+    int i = FindSector(sector);
+
+    if (i == -1)
+        return;
+    if (inodes[i].refCount == 0)
+    {
+        delete inodes[i].hdr;
+        inodes.erase(inodes.begin() + i);
+    }
+    else
+    {
+        inodes[i].sector = -1;
+        inodes[i].dirty = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeCache::Sync
+// 	Write every changed header back to disk.
+//----------------------------------------------------------------------
+
+void InodeCache::Sync()
+{
+    for (int i = 0; i < (int)inodes.size(); i++)
+    {
+        if (inodes[i].dirty)
+        {
+            inodes[i].hdr->WriteBack(inodes[i].sector);
+            inodes[i].dirty = FALSE;
+        }
+    }
+}
+
+//----------------------------------------------------------------------
+// InodeCache::Trim
+// 	Evict the least recently used headers that nobody has open, until
+//	at most "size" of them are left.
+//----------------------------------------------------------------------
+
+void InodeCache::Trim()
+{
+    for (;;)
+    {
+        int unused = 0, victim = -1;
+
+        for (int i = 0; i < (int)inodes.size(); i++)
+        {
+            if (inodes[i].refCount > 0)
+                continue;
+            unused++;
+            if (victim == -1 || inodes[i].lastUsed < inodes[victim].lastUsed)
+                victim = i;
+        }
+        if (unused <= size)
+            return;
+
+        DEBUG(dbgFile, "Inode cache evicting sector " << inodes[victim].sector);
+        if (inodes[victim].dirty)
+            inodes[victim].hdr->WriteBack(inodes[victim].sector);
+        delete inodes[victim].hdr;
+        inodes.erase(inodes.begin() + victim);
+    }
+}
@@ -0,0 +1,66 @@
+// inodecache.h
+//	Data structures for keeping file headers in memory, shared by
+//	everyone who has the file open.
+//
+//	The inode cache is keyed by the sector holding the header.  Every
+//	OpenFile on a file shares one FileHeader (and with it, the header's
+//	cached index blocks), so opening a file or directory that is already
+//	open, or was opened recently, does not touch the disk.
+//
+//	Headers that nobody has open stay cached until the cache holds more
+//	than its size of them; then the least recently used ones are
+//	dropped.  A header that has been changed in memory is written back
+//	when the last reference to it goes away, when it is evicted, or when
+//	the cache is synced.
+
+#ifndef INODECACHE_H
+#define INODECACHE_H
+
+#include "copyright.h"
+#include "filehdr.h"
+#include <vector>
+
+#define InodeCacheSize 32 // unreferenced headers kept in memory
+
+// One cached file header.
+
+class CachedInode
+{
+public:
+    int sector;      // where the header lives on disk; -1 once
+                     //  the file has been removed
+    FileHeader *hdr; // the header itself
+    int refCount;    // number of Acquires not yet Released
+    bool dirty;      // changed since it was read or written back
+    int lastUsed;    // when it was last acquired, for LRU
+};
+
+// The following class defines the inode cache.
+
+class InodeCache
+{
+public:
+    InodeCache(int size); // Keep up to "size" unreferenced headers
+    ~InodeCache();        // Write back and free every header
+
+    FileHeader *Acquire(int sector); // Return the header at "sector",
+                                     //  reading it in if not cached
+    void Release(FileHeader *hdr);   // Give back a header from Acquire
+
+    void MarkDirty(FileHeader *hdr); // The header was changed in memory
+    void Invalidate(int sector);     // The header at "sector" has been
+                                     //  freed; forget it
+
+    void Sync(); // Write back every changed header
+
+private:
+    vector<CachedInode> inodes; // cached headers, in no particular order
+    int size;                   // unreferenced headers we may keep
+    int useClock;               // ticks on every Acquire
+
+    int FindSector(int sector);     // index of the entry for "sector"
+    int FindHeader(FileHeader *hdr); // index of the entry for "hdr"
+    void Trim();                    // evict down to "size"
+};
+
+#endif // INODECACHE_H
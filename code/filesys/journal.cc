@@ -0,0 +1,642 @@
+// journal.cc
+//	Routines to log file system metadata, commit it in groups, and
+//	replay it when the file system is mounted.
+//
+//	See journal.h for what is logged, and when it reaches home.
+//
+//	SynchDisk calls Wants, Capture, Holds and Lookup with its own lock
+//	held, from any thread.  They never wait, so they cannot be
+//	interleaved with each other, or with the parts of Commit and
+//	Checkpoint that move images around, which do not wait either.
+//	The journal's lock is only needed to keep a commit from starting
+//	while a transaction is part way through.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "journal.h"
+#include "synch.h"
+#include "synchdisk.h"
+
+const int JournalMagic = 0x4a726e6c; // front of the journal header
+const int GroupMagic = 0x47727570;   // front of a group in the log
+
+// Dummy function because C++ does not allow pointers to member
+// functions to be passed to Thread::Fork.
+
+static void
+JournalRun(Journal *journal)
+{
+    journal->Run();
+}
+
+//----------------------------------------------------------------------
+// Checksum
+// 	Return a checksum of "numBytes" bytes at "data".
+//----------------------------------------------------------------------
+
+static int
+Checksum(char *data, int numBytes)
+{
+    unsigned int sum = 0;
+
+    for (int i = 0; i < numBytes; i++)
+        sum = ((sum << 1) | (sum >> 31)) + (unsigned char)data[i];
+    return (int)sum;
+}
+
+//----------------------------------------------------------------------
+// Journal::Create
+// 	Write an empty journal onto a disk that is being formatted, and
+//	return it.  The old log is cleared, so that nothing left on the
+//	disk from before can be mistaken for a group.
+//----------------------------------------------------------------------
+
+Journal *
+Journal::Create()
+{
+    char *buffer = new char[LogSectors * SectorSize];
+    vector<SectorBuffer> sectors;
+    Journal *journal = new Journal(1);
+
+    bzero(buffer, LogSectors * SectorSize);
+    for (int i = 0; i < LogSectors; i++)
+        sectors.push_back(SectorBuffer(JournalStart + 1 + i,
+                                       buffer + i * SectorSize));
+    kernel->synchDisk->WriteThrough(sectors);
+    delete [] buffer;
+    journal->WriteHeader();
+    return journal;
+}
+
+//----------------------------------------------------------------------
+// Journal::Open
+// 	Find the journal on a disk that is being mounted, replay what it
+//	holds, and return it.  Return NULL if the disk has no journal.
+//	Must be called before anything else is read from the disk.
+//----------------------------------------------------------------------
+
+Journal *
+Journal::Open()
+{
+    char buffer[SectorSize];
+    JournalHeader header;
+
+    kernel->synchDisk->ReadSector(JournalStart, buffer);
+    bcopy(buffer, (char *)&header, sizeof(JournalHeader));
+    if (header.magic != JournalMagic) {
+        DEBUG(dbgFile, "No journal; updating the disk in place");
+        return NULL;
+    }
+    Replay(&header);
+    return new Journal(header.sequence);
+}
+
+//----------------------------------------------------------------------
+// Journal::Journal
+// 	Initialize an empty log, starting at group "sequence", tell the
+//	disk to pass on writes to be logged, and fork the commit thread,
+//	which waits until a commit is wanted.
+//----------------------------------------------------------------------
+
+Journal::Journal(int sequence)
+{
+    Thread *thread = new Thread("journal", -1);
+
+    this->sequence = sequence;
+    head = 0;
+    lock = new Lock("journal lock");
+    changed = new Condition("journal changed");
+    updates = 0;
+    committing = FALSE;
+    wakeup = new Semaphore("journal wakeup", 0);
+    timerPending = FALSE;
+    kernel->synchDisk->AttachJournal(this);
+    thread->Fork((VoidFunctionPtr)JournalRun, (void *)this);
+}
+
+//----------------------------------------------------------------------
+// Journal::~Journal
+// 	De-allocate the journal.  Nachos is halting; the file system was
+//	synced, and so the journal committed, before the halt began.  If
+//	anything was still not committed, it is lost, as it would be in a
+//	crash; the commit thread is left where it is, asleep.  Nothing
+//	may be written to the disk after this.
+//----------------------------------------------------------------------
+
+Journal::~Journal()
+{
+    map<int, char *>::iterator it;
+
+    kernel->synchDisk->AttachJournal(NULL);
+    for (it = images.begin(); it != images.end(); it++)
+        delete [] it->second;
+    for (it = touched.begin(); it != touched.end(); it++)
+        delete [] it->second;
+    delete lock;
+    delete changed;
+    delete wakeup;
+}
+
+//----------------------------------------------------------------------
+// Journal::Replay
+// 	Apply every complete group in the log, in order, to the home
+//	sectors, then start the log again from the beginning.  The first
+//	group that is missing, out of sequence, or torn ends the log.
+//
+//	"header" -- the journal header; its sequence is moved on past the
+//		groups replayed
+//----------------------------------------------------------------------
+
+void
+Journal::Replay(JournalHeader *header)
+{
+    char *log = new char[LogSectors * SectorSize];
+    map<int, char *> homes;
+    map<int, char *>::iterator it;
+    vector<SectorBuffer> sectors;
+    int at = 0, numGroups = 0;
+
+    while (at < LogSectors) {
+        GroupHeader *group = (GroupHeader *)(log + at * SectorSize);
+        char *records = (char *)(group + 1);
+        int pos;
+
+        kernel->synchDisk->ReadSector(JournalStart + 1 + at, (char *)group);
+        if (group->magic != GroupMagic || group->sequence != header->sequence
+                || group->numSectors < 1 || at + group->numSectors > LogSectors
+                || group->numBytes < 0 || group->numBytes >
+                    group->numSectors * SectorSize - (int)sizeof(GroupHeader))
+            break;
+        sectors.clear();
+        for (int i = 1; i < group->numSectors; i++)
+            sectors.push_back(SectorBuffer(JournalStart + 1 + at + i,
+                                           log + (at + i) * SectorSize));
+        kernel->synchDisk->ReadSectors(sectors);
+        if (Checksum(records, group->numBytes) != group->checksum)
+            break;
+
+        for (pos = 0; pos < group->numBytes; ) {
+            LogRecord record;
+
+            bcopy(records + pos, (char *)&record, sizeof(LogRecord));
+            pos += sizeof(LogRecord);
+            ASSERT(record.sector >= 0 && record.sector < NumSectors);
+            ASSERT(record.offset >= 0 && record.length > 0
+                   && record.offset + record.length <= SectorSize);
+            it = homes.find(record.sector);
+            if (it == homes.end()) {
+                it = homes.insert(pair<int, char *>(record.sector,
+                                            new char[SectorSize])).first;
+                kernel->synchDisk->ReadSector(record.sector, it->second);
+            }
+            bcopy(records + pos, it->second + record.offset, record.length);
+            pos += record.length;
+        }
+        at += group->numSectors;
+        header->sequence++;
+        numGroups++;
+    }
+    delete [] log;
+    if (numGroups == 0)
+        return;
+
+    DEBUG(dbgFile, "Replayed " << numGroups << " groups onto " << homes.size() << " sectors");
+    kernel->stats->numReplayedGroups += numGroups;
+    sectors.clear();
+    for (it = homes.begin(); it != homes.end(); it++)
+        sectors.push_back(SectorBuffer(it->first, it->second));
+    kernel->synchDisk->WriteThrough(sectors);
+    for (it = homes.begin(); it != homes.end(); it++)
+        delete [] it->second;
+
+    char buffer[SectorSize];
+    bzero(buffer, SectorSize);
+    bcopy((char *)header, buffer, sizeof(JournalHeader));
+    kernel->synchDisk->WriteThrough(vector<SectorBuffer>(1,
+                                        SectorBuffer(JournalStart, buffer)));
+}
+
+//----------------------------------------------------------------------
+// Journal::Begin
+// 	Start a transaction for the current thread, waiting first for any
+//	commit under way, or if the thread is already in one, just note
+//	that it has begun another inside it.  Inner transactions are part
+//	of the outer one, and are committed along with it.
+//----------------------------------------------------------------------
+
+void
+Journal::Begin()
+{
+    Thread *thread = kernel->currentThread;
+
+    lock->Acquire();
+    if (depth.find(thread) == depth.end()) {
+        while (committing)
+            changed->Wait(lock);
+        updates++;
+        depth[thread] = 0;
+    }
+    depth[thread]++;
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::End
+// 	End the current thread's transaction.  Once its outermost one
+//	ends, let a commit that is waiting for it go ahead, or commit now
+//	if the running group has grown too big to wait.
+//----------------------------------------------------------------------
+
+void
+Journal::End()
+{
+    Thread *thread = kernel->currentThread;
+    bool full = FALSE;
+
+    lock->Acquire();
+    ASSERT(depth.find(thread) != depth.end());
+    if (--depth[thread] == 0) {
+        depth.erase(thread);
+        updates--;
+        if (committing)
+            changed->Broadcast(lock);
+        else
+            full = ((int)touched.size() >= GroupCommitSectors);
+    }
+    lock->Release();
+    if (full)
+        Commit();
+}
+
+//----------------------------------------------------------------------
+// Journal::Outermost
+// 	Return whether the current thread is in a transaction that it did
+//	not begin inside another one, so that ending it leaves the thread
+//	free to Commit.
+//----------------------------------------------------------------------
+
+bool
+Journal::Outermost()
+{
+    map<Thread *, int>::iterator it;
+    bool outermost;
+
+    lock->Acquire();
+    it = depth.find(kernel->currentThread);
+    outermost = (it != depth.end() && it->second == 1);
+    lock->Release();
+    return outermost;
+}
+
+//----------------------------------------------------------------------
+// Journal::Commit
+// 	Append the running group to the log, as one write, and return once
+//	it is there.  A commit already under way is waited for, and no
+//	transaction may begin until this one is done; those already begun
+//	are waited for, so that the group holds only whole transactions.
+//
+//	If the group does not fit in what is left of the log, checkpoint
+//	first, so that it starts again from the beginning.  If the log is
+//	more than half full once the group is in it, checkpoint.
+//
+//	A group too big for even an empty log is written straight to its
+//	home sectors instead, as on a disk without a journal, so without
+//	the guarantee the log gives.  The file system keeps its
+//	transactions small enough (see Room) that this should not happen.
+//----------------------------------------------------------------------
+
+void
+Journal::Commit()
+{
+    map<int, char *>::iterator it;
+    vector<char> records;
+    vector<SectorBuffer> sectors;
+    vector<int> homes;
+    GroupHeader group;
+    char *buffer;
+
+    ASSERT(depth.find(kernel->currentThread) == depth.end());
+    lock->Acquire();
+    while (committing)
+        changed->Wait(lock);
+    if (touched.empty()) {
+        lock->Release();
+        return;
+    }
+    committing = TRUE;
+    while (updates > 0)
+        changed->Wait(lock);
+
+    // make room first, if the group might not fit in what is left of
+    // the log; its records can only be made once nothing more waits
+    if (head > 0 && head + MaxGroupSectors(touched.size()) > LogSectors)
+        Checkpoint();
+
+    for (it = touched.begin(); it != touched.end(); it++) {
+        AddRecords(records, it->first, it->second, images[it->first]);
+        homes.push_back(it->first);
+        delete [] it->second;
+    }
+    touched.clear();
+
+    if (!records.empty()) {
+        group.magic = GroupMagic;
+        group.sequence = sequence;
+        group.numSectors = divRoundUp(sizeof(GroupHeader) + records.size(),
+                                      SectorSize);
+        group.numBytes = records.size();
+        group.checksum = Checksum(&records[0], records.size());
+        if (group.numSectors > LogSectors)
+            WriteInPlace(homes);
+        else {
+            buffer = new char[group.numSectors * SectorSize];
+            bzero(buffer, group.numSectors * SectorSize);
+            bcopy((char *)&group, buffer, sizeof(GroupHeader));
+            bcopy(&records[0], buffer + sizeof(GroupHeader), records.size());
+            for (int i = 0; i < group.numSectors; i++)
+                sectors.push_back(SectorBuffer(JournalStart + 1 + head + i,
+                                               buffer + i * SectorSize));
+            kernel->synchDisk->WriteThrough(sectors);
+            delete [] buffer;
+
+            DEBUG(dbgFile, "Committed group " << sequence << ": " << records.size() << " bytes in " << group.numSectors << " log sectors");
+            kernel->stats->numJournalCommits++;
+            kernel->stats->numLogSectors += group.numSectors;
+            head += group.numSectors;
+            sequence++;
+            if (head > LogSectors / 2)
+                Checkpoint();
+        }
+    }
+
+    committing = FALSE;
+    changed->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// Journal::MaxGroupSectors
+// 	Return the most log sectors a group that touched "numTouched"
+//	sectors can take up: each sector takes at most a record header and
+//	the whole sector.
+//----------------------------------------------------------------------
+
+int
+Journal::MaxGroupSectors(int numTouched)
+{
+    return divRoundUp(sizeof(GroupHeader)
+                      + numTouched * (sizeof(LogRecord) + SectorSize),
+                      SectorSize);
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteInPlace
+// 	Write the newest images of "homes", sectors of a group too big for
+//	the log, straight to their homes, and stop holding them.  Called
+//	while committing, with the log empty.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteInPlace(vector<int> &homes)
+{
+    char *buffer = new char[homes.size() * SectorSize];
+    vector<SectorBuffer> sectors;
+
+    DEBUG(dbgFile, "Group " << sequence << " is too big for the log; writing " << homes.size() << " sectors in place");
+    for (int i = 0; i < (int)homes.size(); i++) {
+        bcopy(images[homes[i]], buffer + i * SectorSize, SectorSize);
+        sectors.push_back(SectorBuffer(homes[i], buffer + i * SectorSize));
+        delete [] images[homes[i]];
+        images.erase(homes[i]);
+    }
+    kernel->synchDisk->WriteThrough(sectors);
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// Journal::AddRecords
+// 	Append records to "records" for the bytes of a sector that changed
+//	from "before" to "after".  Bytes that changed close together share
+//	a record, when that takes less room than a record each.
+//
+//	"sector" -- the sector that changed
+//	"before" -- what it held when last logged, or NULL if not known
+//	"after" -- what it holds now
+//----------------------------------------------------------------------
+
+void
+Journal::AddRecords(vector<char> &records, int sector, char *before,
+                    char *after)
+{
+    LogRecord record;
+    int start, end, i = 0;
+
+    record.sector = sector;
+    while (i < SectorSize) {
+        if (before != NULL && before[i] == after[i]) {
+            i++;
+            continue;
+        }
+        start = i;
+        end = (before == NULL) ? SectorSize : i + 1;
+        for (int j = end; j < SectorSize
+                 && j - end < (int)sizeof(LogRecord); j++)
+            if (before[j] != after[j])
+                end = j + 1;
+
+        record.offset = start;
+        record.length = end - start;
+        records.insert(records.end(), (char *)&record,
+                       (char *)&record + sizeof(LogRecord));
+        records.insert(records.end(), after + start, after + end);
+        i = end;
+    }
+}
+
+//----------------------------------------------------------------------
+// Journal::Checkpoint
+// 	Write every logged sector home as it was last committed, then
+//	empty the log.  Called while committing.  A sector the running
+//	group has touched -- before that group is written, or, after, by
+//	a write outside a transaction during the commit -- has a newer
+//	image that is not committed: what goes home is what it held
+//	before the group touched it, if that was logged, and its image is
+//	kept, to be logged by the group.  The other images are dropped.
+//----------------------------------------------------------------------
+
+void
+Journal::Checkpoint()
+{
+    map<int, char *>::iterator it, next, before;
+    vector<SectorBuffer> sectors;
+
+    for (it = images.begin(); it != images.end(); it++) {
+        before = touched.find(it->first);
+        if (before == touched.end())
+            sectors.push_back(SectorBuffer(it->first, it->second));
+        else if (before->second != NULL)
+            sectors.push_back(SectorBuffer(it->first, before->second));
+    }
+    DEBUG(dbgFile, "Checkpointing " << sectors.size() << " sectors");
+    kernel->synchDisk->WriteThrough(sectors);
+    for (it = images.begin(); it != images.end(); it = next) {
+        next = it;
+        next++;
+        if (touched.find(it->first) == touched.end()) {
+            delete [] it->second;
+            images.erase(it);
+        }
+    }
+
+    head = 0;
+    WriteHeader();
+    kernel->stats->numCheckpoints++;
+}
+
+//----------------------------------------------------------------------
+// Journal::WriteHeader
+// 	Write the journal header, so that replay starts at the beginning
+//	of the log, expecting the next group to be committed.
+//----------------------------------------------------------------------
+
+void
+Journal::WriteHeader()
+{
+    char buffer[SectorSize];
+    JournalHeader header;
+
+    header.magic = JournalMagic;
+    header.sequence = sequence;
+    bzero(buffer, SectorSize);
+    bcopy((char *)&header, buffer, sizeof(JournalHeader));
+    kernel->synchDisk->WriteThrough(vector<SectorBuffer>(1,
+                                        SectorBuffer(JournalStart, buffer)));
+}
+
+//----------------------------------------------------------------------
+// Journal::Wants
+// 	Return whether a write to "sector" by the current thread is to be
+//	logged: if the thread is in a transaction, or the sector has been
+//	logged since the last checkpoint.
+//----------------------------------------------------------------------
+
+bool
+Journal::Wants(int sector)
+{
+    return depth.find(kernel->currentThread) != depth.end() || Holds(sector);
+}
+
+//----------------------------------------------------------------------
+// Journal::Capture
+// 	Take a write that is to be logged, as the sector's newest image.
+//	The first time the running group touches the sector, remember
+//	what it held before, so that Commit can log just what changed,
+//	and make sure a commit is on the way.
+//
+//	"sector" -- the sector being written
+//	"base" -- its contents on disk, if SynchDisk knows them, else NULL
+//	"data" -- its new contents
+//----------------------------------------------------------------------
+
+void
+Journal::Capture(int sector, char *base, char *data)
+{
+    map<int, char *>::iterator image = images.find(sector);
+    char *before = NULL;
+
+    if (touched.find(sector) == touched.end()) {
+        if (image != images.end() || base != NULL) {
+            before = new char[SectorSize];
+            bcopy((image != images.end()) ? image->second : base, before,
+                  SectorSize);
+        }
+        touched[sector] = before;
+        if (!timerPending) {
+            timerPending = TRUE;
+            kernel->interrupt->Schedule(this, CommitInterval, TimerInt);
+        }
+    }
+    if (image == images.end())
+        image = images.insert(pair<int, char *>(sector,
+                                        new char[SectorSize])).first;
+    bcopy(data, image->second, SectorSize);
+}
+
+//----------------------------------------------------------------------
+// Journal::Room
+// 	Return how many more sectors the running group may touch, and
+//	still be sure to fit in an empty log.
+//----------------------------------------------------------------------
+
+int
+Journal::Room()
+{
+    int room = LogSectors * SectorSize / ((int)sizeof(LogRecord) + SectorSize)
+               - (int)touched.size();
+
+    while (room > 0 && MaxGroupSectors(touched.size() + room) > LogSectors)
+        room--;
+    return room;
+}
+
+//----------------------------------------------------------------------
+// Journal::Holds
+// 	Return whether the journal holds an image of "sector" that may
+//	not have reached its home yet.
+//----------------------------------------------------------------------
+
+bool
+Journal::Holds(int sector)
+{
+    return images.find(sector) != images.end();
+}
+
+//----------------------------------------------------------------------
+// Journal::Lookup
+// 	If the journal holds an image of "sector", copy it into "data" and
+//	return TRUE; otherwise return FALSE, and the sector's home is up
+//	to date.
+//----------------------------------------------------------------------
+
+bool
+Journal::Lookup(int sector, char *data)
+{
+    map<int, char *>::iterator image = images.find(sector);
+
+    if (image == images.end())
+        return FALSE;
+    bcopy(image->second, data, SectorSize);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Journal::CallBack
+// 	Timer interrupt handler: it is time to commit.
+//----------------------------------------------------------------------
+
+void
+Journal::CallBack()
+{
+    timerPending = FALSE;
+    wakeup->V();
+}
+
+//----------------------------------------------------------------------
+// Journal::Run
+// 	Wait for a commit to be wanted, then commit the running group,
+//	forever.
+//----------------------------------------------------------------------
+
+void
+Journal::Run()
+{
+    for (;;) {
+        wakeup->P();
+        Commit();
+    }
+}
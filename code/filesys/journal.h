@@ -0,0 +1,157 @@
+// journal.h
+//	Data structures for a write-ahead journal of file system metadata.
+//
+//	Operations that change the file system (Create, Mkdir, Remove,
+//	growing a file) are run as transactions.  Sectors written during a
+//	transaction -- file headers, directory tables, free map sectors --
+//	do not go to their home on disk.  The journal keeps the newest
+//	image of each one in memory, and SynchDisk hands that image to
+//	anyone who reads the sector meanwhile.
+//
+//	Transactions are committed in groups: every transaction that ends
+//	within CommitInterval ticks of the first joins the same group, and
+//	the whole group is appended to the log as one sequential write.
+//	For each sector the group touched, the log holds only the byte
+//	ranges that changed since it was last logged.  Sync also commits.
+//
+//	Sectors only go home when the log fills up past half way (a
+//	"checkpoint"); the log then starts again from the beginning.  When
+//	the file system is mounted, the groups in the log are replayed
+//	onto their home sectors, so that after a crash, the disk holds
+//	either all of a transaction or none of it.
+//
+//	Once a sector has been logged, every write to it is logged until
+//	the next checkpoint, even outside a transaction, so that the
+//	checkpoint never writes out an older image over a newer one.
+//
+//	The journal occupies JournalSectors sectors near the front of the
+//	disk, next to the free map and directory headers, so that the log
+//	is close to the metadata it is replayed onto: a header sector,
+//	then the log.  A disk formatted before there was a journal does
+//	not have one, and is updated in place, as before.
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "copyright.h"
+#include "callback.h"
+#include "disk.h"
+#include <map>
+#include <vector>
+
+#define JournalSectors 2048 // header sector, plus the log
+#define JournalStart 2 // just after the two well-known headers
+#define LogSectors (JournalSectors - 1)
+
+#define CommitInterval 20000 // ticks a transaction may wait to commit
+#define GroupCommitSectors 64 // sectors a group may touch before it is
+                              //  committed without waiting
+
+class Thread;
+class Lock;
+class Condition;
+class Semaphore;
+
+// The journal header sector: where to start replaying.
+
+class JournalHeader
+{
+public:
+    int magic;    // to check the disk has a journal
+    int sequence; // the group expected first in the log
+};
+
+// The front of each group in the log.  The group's records follow it,
+// and run on into the group's other sectors.
+
+class GroupHeader
+{
+public:
+    int magic;      // to recognize a group
+    int sequence;   // one more than the group before
+    int numSectors; // log sectors the group takes up
+    int numBytes;   // bytes of records
+    int checksum;   // of the records, to catch a torn write
+};
+
+// One record: "length" bytes, stored right after it, go at "offset"
+// in "sector".
+
+class LogRecord
+{
+public:
+    int sector;
+    short offset;
+    short length;
+};
+
+// The following class defines the journal.
+
+class Journal : public CallBackObj
+{
+public:
+    static Journal *Create(); // Start an empty journal, on a disk being
+                              //  formatted
+    static Journal *Open();   // Replay the journal of a disk being
+                              //  mounted; NULL if it has none
+    ~Journal();
+
+    void Begin(); // Start a transaction, or join the
+    void End();   //  one this thread is in; end it
+    bool Outermost(); // Is this thread in a transaction, not
+                      //  one begun inside another?
+    void Commit(); // Make every ended transaction durable
+    int Room();    // Sectors the running group may still
+                   //  touch and be sure to fit in the log
+
+    // Called by SynchDisk, with its lock held
+    bool Wants(int sector); // Should a write to "sector" be logged?
+    void Capture(int sector, char *base, char *data);
+    // Take a write that is to be logged;
+    //  "base" is the sector as it is on
+    //  disk, if known, else NULL
+    bool Holds(int sector);              // Is an image of "sector" held?
+    bool Lookup(int sector, char *data); // Copy out the newest image of
+                                         //  "sector", if it is held here
+
+    void CallBack(); // Called when the commit timer goes off
+    void Run();      // Body of the commit thread; never returns
+
+private:
+    Journal(int sequence); // Start the commit thread
+    static void Replay(JournalHeader *header);
+    // Apply the groups in the log
+    static void AddRecords(vector<char> &records, int sector,
+                           char *before, char *after);
+    // Log the bytes of "after" that
+    //  differ from "before" (all of
+    //  them, if "before" is NULL)
+    static int MaxGroupSectors(int numTouched);
+    // Most log sectors a group can need
+    void Checkpoint();      // Write every logged sector home, and
+                            //  empty the log
+    void WriteInPlace(vector<int> &homes);
+    // Write a group too big for the log
+    //  straight home
+    void WriteHeader();     // Write out "sequence" as the header
+
+    int sequence; // the next group to commit
+    int head;     // the log sector it goes to
+
+    map<int, char *> images;  // newest image of each logged sector
+    map<int, char *> touched; // what each sector touched by the
+                              //  running group was before it;
+                              //  NULL if not known
+    map<Thread *, int> depth; // transactions each thread has begun
+                              //  and not yet ended
+
+    Lock *lock;         // protects "updates" and "committing"
+    Condition *changed; // signalled when either one changes
+    int updates;        // threads in a transaction
+    bool committing;    // is a commit waiting or writing?
+
+    Semaphore *wakeup; // V'ed when a commit is wanted
+    bool timerPending; // is the commit timer already set?
+};
+
+#endif // JOURNAL_H
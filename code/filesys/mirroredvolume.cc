@@ -0,0 +1,256 @@
+// mirroredvolume.cc
+//	Routines to keep the two disks of a mirrored volume the same.
+//
+//	Every piece of a request goes to a single disk, unsplit, since
+//	each mirror holds the whole volume at the same sectors.  As with
+//	a striped volume, requests that touch the same sector reach each
+//	disk in order, because each disk's own queue keeps them so.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "mirroredvolume.h"
+#include "synch.h"
+
+const int MirrorMagic = 0x4d697272; // front of a mirror state file
+
+// Wakes the resyncing thread once a disk request is done.
+
+class ResyncDone : public CallBackObj {
+  public:
+    ResyncDone() { semaphore = new Semaphore("resync", 0); }
+    ~ResyncDone() { delete semaphore; }
+
+    void CallBack() { semaphore->V(); }
+    void Wait() { semaphore->P(); }
+
+  private:
+    Semaphore *semaphore;
+};
+
+//----------------------------------------------------------------------
+// MirroredVolume::MirroredVolume
+// 	Initialize the two mirrors, and find out from the state file which
+//	of them, if either, is stale.  A mirror whose UNIX file had to be
+//	created is stale from end to end, unless the volume is new.  A
+//	mirror left offline is stale from now on, and the volume starts
+//	recording which chunks it misses; if it was offline last time
+//	but missed nothing, it is not stale after all.
+//
+//	Nachos cannot run at all if the only up-to-date mirror is offline
+//	or missing.
+//
+//	"policy" -- the order in which each disk's queue serves requests
+//	"mapped" -- map the disks' UNIX files into memory
+//	"model" -- how long each disk takes to serve a request
+//	"offline" -- the mirror (0 or 1) to leave out, or -1
+//----------------------------------------------------------------------
+
+MirroredVolume::MirroredVolume(DiskPolicy policy, bool mapped, DiskModel model,
+                               int offline)
+    : DiskArray(2, policy, mapped, model, offline)
+{
+    int fd, i, other;
+    bool existed;
+
+    sprintf(stateName, "DISK_%d.mirror", kernel->hostName);
+    fd = OpenForReadWrite(stateName, FALSE);
+    existed = (fd >= 0);
+    if (existed) {
+        Read(fd, (char *) &state, sizeof(MirrorState));
+        Close(fd);
+        ASSERT(state.magic == MirrorMagic);
+    } else {
+        state.magic = MirrorMagic;
+        state.stale = -1;
+        state.wholeDisk = FALSE;
+        for (i = 0; i < NumResyncChunks; i++)
+            state.chunks[i] = FALSE;
+    }
+
+    if (state.stale != -1 && !state.wholeDisk) {
+        for (i = 0; i < NumResyncChunks && !state.chunks[i]; i++)
+            ;
+        if (i == NumResyncChunks)       // offline, but missed nothing
+            state.stale = -1;
+    }
+    for (i = 0; i < 2; i++) {
+        other = 1 - i;
+        if (disks[i] == NULL || !disks[i]->NewDisk() || !existed)
+            continue;
+        if (disks[other] == NULL || disks[other]->NewDisk()
+                || state.stale == other) {
+            cerr << "Mirrored volume: no up-to-date mirror is online\n";
+            Abort();
+        }
+        DEBUG(dbgDisk, "Mirror " << (char)('a' + i) << " is new, and so stale");
+        state.stale = i;
+        state.wholeDisk = TRUE;
+    }
+    if (offline != -1) {
+        if (state.stale == 1 - offline) {
+            cerr << "Mirrored volume: mirror " << (char)('a' + offline)
+                 << " is the only up-to-date one, and cannot be offline\n";
+            Abort();
+        }
+        DEBUG(dbgDisk, "Mirror " << (char)('a' + offline) << " is offline");
+        state.stale = offline;
+    }
+    SaveState();
+    lastRead = 1;
+}
+
+//----------------------------------------------------------------------
+// MirroredVolume::Submit
+// 	Queue a write with every mirror that is online, or a read with
+//	the one that should serve it soonest.  Return without waiting; the
+//	request's "whenDone" is called, and the request deleted, once it
+//	has completed everywhere.
+//
+//	While a mirror is stale, the chunks a write touches are recorded
+//	as stale before the write is queued.
+//----------------------------------------------------------------------
+
+void
+MirroredVolume::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    RequestPieces *pieces = new RequestPieces(this, request);
+    int i;
+
+    if (request->writing) {
+        if (state.stale != -1)
+            MarkStale(request->sector, request->numSectors);
+        for (i = 0; i < 2; i++)
+            if (disks[i] != NULL)
+                SubmitPiece(i, request->sector, &request->data[0],
+                            request->numSectors, TRUE, pieces);
+    } else {
+        i = ChooseMirror(request);
+        kernel->stats->numMirrorReads[i]++;
+        SubmitPiece(i, request->sector, &request->data[0],
+                    request->numSectors, FALSE, pieces);
+    }
+    kernel->interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// MirroredVolume::ChooseMirror
+// 	Return which mirror should serve a read: one that is online and
+//	not stale, and of those, the one whose queue predicts the shorter
+//	wait.  On a tie, alternate, so that the heads spread out over the
+//	disk.
+//----------------------------------------------------------------------
+
+int
+MirroredVolume::ChooseMirror(DiskRequest *request)
+{
+    int latency[2];
+    int choice;
+
+    for (int i = 0; i < 2; i++)
+        if (disks[i] == NULL || state.stale == i)
+            return 1 - i;
+    for (int i = 0; i < 2; i++)
+        latency[i] = disks[i]->PredictLatency(request->sector, FALSE,
+                                              request->numSectors);
+    if (latency[0] == latency[1])
+        choice = 1 - lastRead;
+    else
+        choice = (latency[0] < latency[1]) ? 0 : 1;
+    lastRead = choice;
+    return choice;
+}
+
+//----------------------------------------------------------------------
+// MirroredVolume::MarkStale
+// 	Record that a run of sectors is about to be written while a
+//	mirror is stale, so that Resync will copy them.  The state file is
+//	rewritten whenever a chunk is added.
+//----------------------------------------------------------------------
+
+void
+MirroredVolume::MarkStale(int sector, int numSectors)
+{
+    bool added = FALSE;
+
+    if (state.wholeDisk)
+        return;
+    for (int c = sector / ResyncChunk; c <= (sector + numSectors - 1) / ResyncChunk; c++)
+        if (!state.chunks[c]) {
+            state.chunks[c] = TRUE;
+            added = TRUE;
+        }
+    if (added)
+        SaveState();
+}
+
+//----------------------------------------------------------------------
+// MirroredVolume::Resync
+// 	If a mirror is stale, and online, copy each stale chunk to it from
+//	the other mirror, then record that it is up to date.  Return only
+//	once it is.
+//
+//	Nothing else may use the volume meanwhile: this is meant to run
+//	when Nachos starts, before the file system does.
+//----------------------------------------------------------------------
+
+void
+MirroredVolume::Resync()
+{
+    int stale = state.stale, good = 1 - state.stale;
+    char *buffer;
+    char *data[ResyncChunk];
+    ResyncDone done;
+    int c, i, numChunks = 0;
+
+    if (stale == -1 || disks[stale] == NULL)
+        return;
+
+    buffer = new char[ResyncChunk * SectorSize];
+    for (i = 0; i < ResyncChunk; i++)
+        data[i] = buffer + i * SectorSize;
+    for (c = 0; c < NumResyncChunks; c++) {
+        if (!state.wholeDisk && !state.chunks[c])
+            continue;
+        disks[good]->Submit(new DiskRequest(c * ResyncChunk, data, ResyncChunk,
+                                            FALSE, &done));
+        done.Wait();
+        disks[stale]->Submit(new DiskRequest(c * ResyncChunk, data, ResyncChunk,
+                                             TRUE, &done));
+        done.Wait();
+        kernel->stats->numResyncSectors += ResyncChunk;
+        numChunks++;
+    }
+    delete [] buffer;
+    DEBUG(dbgDisk, "Resynced " << numChunks << " chunks to mirror " << (char)('a' + stale));
+
+    disks[stale]->Sync();
+    state.stale = -1;
+    state.wholeDisk = FALSE;
+    for (c = 0; c < NumResyncChunks; c++)
+        state.chunks[c] = FALSE;
+    SaveState();
+}
+
+//----------------------------------------------------------------------
+// MirroredVolume::SaveState
+// 	Write what is stale to the state file, overwriting it in place.
+//----------------------------------------------------------------------
+
+void
+MirroredVolume::SaveState()
+{
+    int fd = OpenForReadWrite(stateName, FALSE);
+
+    if (fd < 0)
+        fd = OpenForWrite(stateName);
+    else
+        Lseek(fd, 0, 0);
+    WriteFile(fd, (char *) &state, sizeof(MirrorState));
+    Close(fd);
+}
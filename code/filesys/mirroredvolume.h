@@ -0,0 +1,73 @@
+// mirroredvolume.h
+//	Data structures for a mirrored (RAID-1) volume: two simulated
+//	disks, DISK_<host>a and DISK_<host>b, holding the same sectors.
+//
+//	Every write goes to both disks.  A read goes to whichever disk is
+//	predicted to finish it sooner, from where its head is and what it
+//	already has queued, so that two readers can be served at once.
+//
+//	One mirror can be left offline.  The volume then carries on with
+//	the other, recording which parts of the volume it has written
+//	since ("resync chunks").  When the offline mirror comes back, it
+//	is stale: it gets no reads until Resync has copied those chunks
+//	across to it from the up-to-date mirror.  A mirror whose UNIX file
+//	has gone missing is stale from end to end.
+//
+//	What is stale is kept in a small UNIX file, DISK_<host>.mirror, so
+//	that it is known across runs of Nachos.  A chunk is recorded there
+//	before any write to it, so a crash cannot lose track of one.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MIRROREDVOLUME_H
+#define MIRROREDVOLUME_H
+
+#include "copyright.h"
+#include "diskarray.h"
+
+const int ResyncChunk = 1024; // sectors per resync chunk
+const int NumResyncChunks = NumSectors / ResyncChunk;
+
+// What is stale, as kept in the state file.
+
+class MirrorState
+{
+public:
+    int magic;                   // to check it is a mirror state file
+    int stale;                   // the stale mirror, or -1 if none
+    bool wholeDisk;              // is all of it stale?
+    bool chunks[NumResyncChunks]; // otherwise, which chunks
+};
+
+// The following class defines a mirrored volume.
+
+class MirroredVolume : public DiskArray
+{
+public:
+    MirroredVolume(DiskPolicy policy, bool mapped, DiskModel model,
+                   int offline = -1);
+    // Create the two mirrors, leaving
+    //  out mirror "offline" if it is
+    //  0 or 1; the rest is as for
+    //  DiskArray
+
+    void Submit(DiskRequest *request); // Write to both mirrors, or read
+                                       //  from the better one
+    void Resync(); // Bring a stale mirror up to date,
+                   //  returning once it is
+
+private:
+    int ChooseMirror(DiskRequest *request); // Mirror to read from
+    void MarkStale(int sector, int numSectors);
+    // Record that a run of sectors is
+    //  missing from the stale mirror
+    void SaveState(); // Write "state" to its UNIX file
+
+    char stateName[32]; // name of the state file
+    MirrorState state;  // what is stale
+    int lastRead;       // mirror chosen for the last read
+};
+
+#endif // MIRROREDVOLUME_H
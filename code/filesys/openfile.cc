@@ -16,21 +16,30 @@
 #include "main.h"
 #include "filehdr.h"
 #include "openfile.h"
+#include "inodecache.h"
 #include "synchdisk.h"
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open.  The header comes from the
+//	kernel's inode cache, and is shared with anyone else who has the
+//	same file open.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = kernel->inodeCache->Acquire(sector);
+    hdrSector = sector;
+    isDirectory = FALSE;
     seekPosition = 0;
+    bounce = new char[2 * SectorSize];
+    nextPosition = 0;
+    readAheadWindow = 0;
+    readAheadEnd = 0;
+    readAheadMark = 0;
 }
 
 //----------------------------------------------------------------------
@@ -40,7 +49,8 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    kernel->inodeCache->Release(hdr);
+    delete [] bounce;
 }
 
 //----------------------------------------------------------------------
@@ -96,14 +106,26 @@ OpenFile::Write(char *into, int numBytes)
 //	boundary; however the disk only knows how to read/write a whole disk
 //	sector at a time.  Thus:
 //
+//	Sectors wholly inside the request are transferred straight to or
+//	from the caller's buffer.  Only a partial first or last sector goes
+//	through the open file's two-sector bounce buffer.  All the sectors
+//	are handed to the disk together, so each run of consecutive sectors
+//	is a single disk request:
+//
 //	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   We read in the partial sector, but we only copy the part we are
+//	   interested in.
 //	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
+//	   We must first read in a sector that will be partially written,
 //	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	   in the data that will be modified, and write the sector back.
+//	   A write that runs past the end of the file first grows the file;
+//	   any gap between the old end and "position" is filled with zeroes.
+//
+//	The data of a small file lives in its header, which was read in
+//	when the file was opened, so those files need no sector I/O to
+//	read.  Writing to them only changes the cached header, which is
+//	written back when the file is closed.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -116,8 +138,10 @@ int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int i, j, offset, start, end, numPartial = 0;
+    int partialStart[2], partialEnd[2];
+    vector<Extent> runs;
+    vector<SectorBuffer> sectors;
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
@@ -125,19 +149,36 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
+    if (hdr->IsInline()) {
+        hdr->ReadInline(into, numBytes, position);
+        return numBytes;
+    }
+
+    // read every sector we need with one call, so that each run of
+    // consecutive disk sectors is a single disk request; "offset" is
+    // where in the file the current sector starts
+    runs = hdr->ByteRangeToSectors(position, numBytes);
+    offset = divRoundDown(position, SectorSize) * SectorSize;
+    for (i = 0; i < (int)runs.size(); i++)
+        for (j = 0; j < runs[i].length; j++, offset += SectorSize) {
+            start = max(position, offset);
+            end = min(position + numBytes, offset + SectorSize);
+            if (end - start == SectorSize)	// whole sector, no copy
+                sectors.push_back(SectorBuffer(runs[i].start + j, &into[start - position]));
+            else {				// partial, via the bounce buffer
+                sectors.push_back(SectorBuffer(runs[i].start + j, &bounce[numPartial * SectorSize]));
+                partialStart[numPartial] = start;
+                partialEnd[numPartial++] = end;
+            }
+        }
+    kernel->synchDisk->ReadSectors(sectors);
 
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    // copy the part we want out of any partial sectors
+    for (i = 0; i < numPartial; i++)
+        bcopy(&bounce[i * SectorSize + partialStart[i] % SectorSize], 
+		&into[partialStart[i] - position], partialEnd[i] - partialStart[i]);
 
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    ReadAhead(position, numBytes);
     return numBytes;
 }
 
@@ -145,46 +186,123 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+    int i, j, offset, start, end, numPartial = 0;
+    int partialStart[2], partialEnd[2];
+    vector<Extent> runs;
+    vector<SectorBuffer> sectors, partial;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position < 0))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
-	numBytes = fileLength - position;
+    if ((position + numBytes) > fileLength) {
+	if (kernel->fileSystem->ExtendFile(hdr, hdrSector, position + numBytes)) {
+	    if (position > fileLength) {	// zero the gap we skipped over
+		char *zeroes = new char[position - fileLength];
+		memset(zeroes, 0, position - fileLength);
+		WriteAt(zeroes, position - fileLength, fileLength);
+		delete [] zeroes;
+	    }
+	    fileLength = position + numBytes;
+	} else if (position >= fileLength)
+	    return 0;
+	else
+	    numBytes = fileLength - position;
+    }
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-	
-	// Mp4 mod tag
-	memset(buf, 0, sizeof(char) * numSectors * SectorSize); // dummy operation to keep valgrind happy
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
-
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
-
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
+    if (hdr->IsInline()) {
+        hdr->WriteInline(from, numBytes, position);
+        kernel->inodeCache->MarkDirty(hdr);
+        return numBytes;
+    }
+
+    // list every sector we change, so that they can all be written with
+    // one call; "offset" is where in the file the current sector starts
+    runs = hdr->ByteRangeToSectors(position, numBytes);
+    offset = divRoundDown(position, SectorSize) * SectorSize;
+    for (i = 0; i < (int)runs.size(); i++)
+        for (j = 0; j < runs[i].length; j++, offset += SectorSize) {
+            start = max(position, offset);
+            end = min(position + numBytes, offset + SectorSize);
+            if (end - start == SectorSize)	// whole sector, no copy
+                sectors.push_back(SectorBuffer(runs[i].start + j, &from[start - position]));
+            else {				// partial, via the bounce buffer
+                partial.push_back(SectorBuffer(runs[i].start + j, &bounce[numPartial * SectorSize]));
+                sectors.push_back(partial.back());
+                partialStart[numPartial] = start;
+                partialEnd[numPartial++] = end;
+            }
+        }
+
+    // read in any partial sectors, so that we don't overwrite the
+    // unmodified portion, and copy in the bytes we want to change
+    kernel->synchDisk->ReadSectors(partial);
+    for (i = 0; i < numPartial; i++)
+        bcopy(&from[partialStart[i] - position], 
+		&bounce[i * SectorSize + partialStart[i] % SectorSize], 
+		partialEnd[i] - partialStart[i]);
+
+    kernel->synchDisk->WriteSectors(sectors);
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called after each read from the file's sectors, to guess what will
+//	be read next.  A read that starts where the last one ended means
+//	the file is being read in order.  Once such a read gets into the
+//	second half of the data read ahead last time, the next window of
+//	sectors is prefetched into the block cache, and the window after
+//	that will be twice as big (up to MaxReadAhead).  A read anywhere
+//	else halves the window, and below MinReadAhead turns read-ahead
+//	off until the file is again read in order.  The window is never
+//	more than half the block cache, so that read-ahead does not push
+//	out the sectors it has just read.
+//
+//	"position" -- where in the file the read started
+//	"numBytes" -- how many bytes were read
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int position, int numBytes)
+{
+    int end = position + numBytes;
+    int limit = min(MaxReadAhead, kernel->synchDisk->CacheSize() / 2);
+    int start, length;
+    vector<Extent> runs;
+
+    if (limit < MinReadAhead)
+        return;				// too little cache to read ahead
+
+    if (position != nextPosition) {	// not in order
+        readAheadWindow /= 2;
+        if (readAheadWindow < MinReadAhead)
+            readAheadWindow = 0;
+        readAheadEnd = readAheadMark = 0;
+        nextPosition = end;
+        return;
+    }
+    nextPosition = end;
+    if (readAheadWindow == 0)
+        readAheadWindow = MinReadAhead;
+    if (end < readAheadMark)
+        return;				// still well inside the last window
+
+    start = max(readAheadEnd, divRoundUp(end, SectorSize) * SectorSize);
+    length = min(readAheadWindow * SectorSize, hdr->FileLength() - start);
+    if (length <= 0)
+        return;				// nothing left to read
+
+    DEBUG(dbgFile, "Reading ahead " << divRoundUp(length, SectorSize) << " sectors at " << start);
+    kernel->stats->numReadAheads++;
+    kernel->stats->maxReadAheadWindow = max(kernel->stats->maxReadAheadWindow, readAheadWindow);
+    runs = hdr->ByteRangeToSectors(start, length);
+    for (int i = 0; i < (int)runs.size(); i++)
+        kernel->synchDisk->Prefetch(runs[i].start, runs[i].length);
+    readAheadEnd = start + length;
+    readAheadMark = start + length / 2;
+    readAheadWindow = min(2 * readAheadWindow, limit);
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
@@ -62,6 +62,10 @@ class OpenFile {
 #else // FILESYS
 class FileHeader;
 
+#define MinReadAhead 4		// sectors read ahead when a file first
+				// looks like it is being read in order
+#define MaxReadAhead 64		// most sectors ever read ahead at once
+
 class OpenFile {
   public:
     OpenFile(int sector);		// Open a file whose header is located
@@ -86,10 +90,34 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+
+    int HeaderSector() { return hdrSector; }
+					// Where the file's header is, which
+					// names the file (or directory)
+    void MarkDirectory() { isDirectory = TRUE; }
+					// Note that this handle came from
+					// OpenDir, and names a directory
+    bool IsDirectory() { return isDirectory; }
     
   private:
+    void ReadAhead(int position, int numBytes);
+    					// Note a read, and if the file is
+					// being read in order, prefetch
+					// what is likely to be read next
+
     FileHeader *hdr;			// Header for this file 
+    int hdrSector;			// Disk sector holding the header
+    bool isDirectory;			// Opened as a directory, by OpenDir
     int seekPosition;			// Current position within the file
+    char *bounce;			// Two sectors, for the partial sectors
+					// at either end of a transfer
+    int nextPosition;			// Where the next read starts, if
+					// the file is read in order
+    int readAheadWindow;		// Sectors to read ahead next time;
+					// 0 while reads look random
+    int readAheadEnd;			// Where the data read ahead ends
+    int readAheadMark;			// Halfway through it: reaching here
+					// starts the next window
 };
 
 #endif // FILESYS
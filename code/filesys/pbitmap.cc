@@ -7,7 +7,9 @@
 // of liability and disclaimer of warranty provisions.
 
 #include "copyright.h"
+#include "debug.h"
 #include "pbitmap.h"
+#include "disk.h"
 
 //----------------------------------------------------------------------
 // PersistentBitmap::PersistentBitmap(int)
@@ -16,11 +18,17 @@
 //
 //	"numItems" is the number of bits in the bitmap.
 //
-//      This constructor does not initialize the bitmap from a disk file
+//      This constructor does not initialize the bitmap from a disk file,
+//	so the whole map is considered changed, and the first WriteBack
+//	writes all of it.
 //----------------------------------------------------------------------
 
 PersistentBitmap::PersistentBitmap(int numItems):Bitmap(numItems) 
 { 
+    numMapSectors = divRoundUp(numWords * sizeof(unsigned), SectorSize);
+    dirty = new Bitmap(numMapSectors);
+    for (int i = 0; i < numMapSectors; i++)
+        dirty->Mark(i);
 }
 
 //----------------------------------------------------------------------
@@ -41,6 +49,9 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
     // but we will just overwrite that with the contents of the
     // map found in the file
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    numMapSectors = divRoundUp(numWords * sizeof(unsigned), SectorSize);
+    dirty = new Bitmap(numMapSectors);
 }
 
 //----------------------------------------------------------------------
@@ -50,6 +61,7 @@ PersistentBitmap::PersistentBitmap(OpenFile *file, int numItems):Bitmap(numItems
 
 PersistentBitmap::~PersistentBitmap()
 { 
+    delete dirty;
 }
 
 //----------------------------------------------------------------------
@@ -63,11 +75,17 @@ void
 PersistentBitmap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    for (int i = 0; i < numMapSectors; i++)
+        dirty->Clear(i);
 }
 
 //----------------------------------------------------------------------
 // PersistentBitmap::WriteBack
 // 	Store the contents of a persistent bitmap to a Nachos file.
+//	Only the sectors of the file holding bits that changed since the
+//	last FetchFrom/WriteBack are written; adjacent changed sectors
+//	are written together.
 //
 //	"file" is the place to write the bitmap to
 //----------------------------------------------------------------------
@@ -75,5 +93,145 @@ PersistentBitmap::FetchFrom(OpenFile *file)
 void
 PersistentBitmap::WriteBack(OpenFile *file)
 {
-   file->WriteAt((char *)map, numWords * sizeof(unsigned), 0);
+    int mapBytes = numWords * sizeof(unsigned);
+    int first, last, offset;
+
+    first = 0;
+    while (first < numMapSectors) {
+        if (!dirty->Test(first)) {
+            first++;
+            continue;
+        }
+        for (last = first; last < numMapSectors && dirty->Test(last); last++)
+            dirty->Clear(last);
+
+        offset = first * SectorSize;
+        file->WriteAt((char *)map + offset, min(last * SectorSize, mapBytes) - offset, offset);
+        first = last;
+    }
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::IsDirty
+// 	Return TRUE if any bits changed since the last FetchFrom/WriteBack.
+//----------------------------------------------------------------------
+
+bool
+PersistentBitmap::IsDirty() const
+{
+    return dirty->NumClear() < numMapSectors;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::SetDirty
+// 	Remember that the sector of the bitmap file holding bit "which"
+//	has to be written back.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::SetDirty(int which)
+{
+    dirty->Mark((which / BitsInByte) / SectorSize);
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::Mark/Clear/FindAndSet
+// 	The same as for an ordinary bitmap, except that the changed bit
+//	is remembered, so that WriteBack knows what to write.
+//----------------------------------------------------------------------
+
+void
+PersistentBitmap::Mark(int which)
+{
+    Bitmap::Mark(which);
+    SetDirty(which);
+}
+
+void
+PersistentBitmap::Clear(int which)
+{
+    Bitmap::Clear(which);
+    SetDirty(which);
+}
+
+int
+PersistentBitmap::FindAndSet()
+{
+    int which = Bitmap::FindAndSet();
+
+    if (which >= 0)
+        SetDirty(which);
+    return which;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::AllocateRun
+// 	Allocate a run of contiguous free sectors.  The run starts at the
+//	first free sector at or after "hint" (wrapping around to the start
+//	of the disk if there is none), and is extended up to "count"
+//	sectors, or until it runs into a sector that is already in use.
+//
+//	Return the first sector of the run, and set "*length" to the
+//	number of sectors in it.  If there are no free sectors, return -1.
+//
+//	"count" is the most sectors the caller wants
+//	"hint" is the goal sector, usually just past the caller's
+//	    previous allocation
+//	"length" is set to the number of sectors actually allocated
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::AllocateRun(int count, int hint, int *length)
+{
+    int start, len;
+
+    ASSERT(count > 0);
+
+    if (hint < 0 || hint >= numBits)
+        hint = 0;
+    start = FindClear(hint);
+    if (start == -1)
+        start = FindClear(0);
+    if (start == -1) {
+        *length = 0;
+        return -1;
+    }
+
+    for (len = 0; len < count && start + len < numBits; len++) {
+        if (Test(start + len))
+            break;
+        Mark(start + len);
+    }
+    *length = len;
+    return start;
+}
+
+//----------------------------------------------------------------------
+// PersistentBitmap::AllocateSectors
+// 	Fill in "sectors" with "count" newly allocated sector numbers,
+//	taking them as contiguous runs starting near "goal", so that
+//	consecutive blocks of a file end up on consecutive sectors.
+//
+//	The caller must already have checked that there is enough free
+//	space.  Return the sector just past the last one allocated, to be
+//	used as the goal for the caller's next allocation.
+//----------------------------------------------------------------------
+
+int
+PersistentBitmap::AllocateSectors(int *sectors, int count, int goal)
+{
+    int done = 0;
+
+    while (done < count) {
+        int length;
+        int start = AllocateRun(count - done, goal, &length);
+
+        // since the caller checked that there was enough free space,
+        // we expect this to succeed
+        ASSERT(start >= 0);
+        for (int i = 0; i < length; i++)
+            sectors[done++] = start + i;
+        goal = start + length;
+    }
+    return goal;
 }
@@ -20,6 +20,10 @@
 // The following class defines a persistent bitmap.  It inherits all
 // the behavior of a bitmap (see bitmap.h), adding the ability to
 // be read from and stored to the disk.
+//
+// The bitmap remembers which sectors of its file hold bits that have
+// changed since it was last fetched or written, so that WriteBack only
+// writes those sectors rather than the whole map.
 
 class PersistentBitmap : public Bitmap {
   public:
@@ -29,7 +33,27 @@ class PersistentBitmap : public Bitmap {
     ~PersistentBitmap(); 			// deallocate bitmap
 
     void FetchFrom(OpenFile *file);     // read bitmap from the disk
-    void WriteBack(OpenFile *file); 	// write bitmap contents to disk 
+    void WriteBack(OpenFile *file); 	// write changed parts of the
+					// bitmap back to disk
+    bool IsDirty() const;		// anything to write back?
+
+    void Mark(int which);		// Set/clear the "nth" bit, and
+    void Clear(int which);		// remember that it needs writing
+    int FindAndSet();
+
+    int AllocateRun(int count, int hint, int *length);
+					// Allocate up to "count" contiguous
+					// sectors, starting with the first
+					// free sector at or after "hint"
+    int AllocateSectors(int *sectors, int count, int goal);
+					// Allocate "count" sectors as a
+					// series of runs near "goal"
+
+  private:
+    int numMapSectors;			// number of sectors of the bitmap file
+    Bitmap *dirty;			// which of those sectors have changed
+
+    void SetDirty(int which);		// note that bit "which" has changed
 };
 
 #endif // PBITMAP_H
@@ -12,16 +12,12 @@ SingleIndirect::SingleIndirect()
 
 SingleIndirect::~SingleIndirect() {}
 
-bool SingleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount)
+bool SingleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount, int *goal)
 {
     numSectors = sectorAmount;
-    for (int i = 0; i < sectorAmount; i++)
-    {
-        dataSectors[i] = freeMap->FindAndSet();
-        // since we checked that there was enough free space,
-        // we expect this to succeed
-        ASSERT(dataSectors[i] >= 0);
-    }
+    // data sectors are taken as contiguous runs, following on from
+    // whatever was allocated for this file last
+    *goal = freeMap->AllocateSectors(dataSectors, sectorAmount, *goal);
     return true;
 }
 
@@ -0,0 +1,75 @@
+// stripedvolume.cc
+//	Routines to split requests to a striped volume between its disks.
+//
+//	Volume sector s is in stripe unit u = s / stripeUnit, which is on
+//	disk u % numDisks, at sector (u / numDisks) * stripeUnit +
+//	s % stripeUnit there.  Successive units on one disk are next to
+//	each other on that disk, so all of a request that falls on one
+//	disk is consecutive there, and goes to it as a single run.
+//
+//	Two requests that touch the same volume sector touch the same
+//	sector of the same disk, and that disk's queue keeps them in
+//	order, so the volume needs no ordering of its own.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "debug.h"
+#include "main.h"
+#include "stripedvolume.h"
+
+//----------------------------------------------------------------------
+// StripedVolume::StripedVolume
+// 	Initialize the disks of a striped volume.
+//
+//	"numDisks" -- how many disks to stripe across
+//	"stripeUnit" -- how many consecutive sectors go to each disk in turn
+//	"policy" -- the order in which each disk's queue serves requests
+//	"mapped" -- map the disks' UNIX files into memory
+//	"model" -- how long each disk takes to serve a request
+//----------------------------------------------------------------------
+
+StripedVolume::StripedVolume(int numDisks, int stripeUnit, DiskPolicy policy,
+                             bool mapped, DiskModel model)
+    : DiskArray(numDisks, policy, mapped, model)
+{
+    ASSERT(stripeUnit > 0);
+    this->stripeUnit = stripeUnit;
+}
+
+//----------------------------------------------------------------------
+// StripedVolume::Submit
+// 	Split a request into one piece per disk it touches, and queue
+//	each piece with its disk.  Return without waiting; the request's
+//	"whenDone" is called, and the request deleted, once every piece
+//	has completed.
+//----------------------------------------------------------------------
+
+void
+StripedVolume::Submit(DiskRequest *request)
+{
+    IntStatus oldLevel = kernel->interrupt->SetLevel(IntOff);
+    RequestPieces *pieces = new RequestPieces(this, request);
+    vector<vector<char *> > data(numDisks); // each disk's buffers
+    vector<int> start(numDisks);             // and first sector there
+    int i, unit, disk, sector;
+
+    for (i = 0; i < request->numSectors; i++) {
+        unit = (request->sector + i) / stripeUnit;
+        disk = unit % numDisks;
+        sector = (unit / numDisks) * stripeUnit
+                    + (request->sector + i) % stripeUnit;
+        if (data[disk].empty())
+            start[disk] = sector;
+        ASSERT(sector == start[disk] + (int)data[disk].size());
+        data[disk].push_back(request->data[i]);
+    }
+    for (disk = 0; disk < numDisks; disk++)
+        if (!data[disk].empty())
+            SubmitPiece(disk, start[disk], &data[disk][0], data[disk].size(),
+                        request->writing, pieces);
+    DEBUG(dbgDisk, "Striped " << request->numSectors << " sectors at " << request->sector << " into " << pieces->remaining << " pieces");
+    kernel->interrupt->SetLevel(oldLevel);
+}
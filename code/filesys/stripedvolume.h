@@ -0,0 +1,47 @@
+// stripedvolume.h
+//	Data structures for a striped (RAID-0) volume: several simulated
+//	disks presented as one.
+//
+//	The volume's sectors are dealt out to the disks in "stripe units"
+//	of a fixed number of consecutive sectors: the first unit goes to
+//	disk a, the next to disk b, and so on, wrapping round to disk a
+//	again.  So a long run of sectors is split between all the disks,
+//	and each disk has its own queue and its own head; the pieces of a
+//	request, or requests that land on different disks, are served at
+//	the same time.
+//
+//	The volume has as many sectors as a single disk (NumSectors), so
+//	the file system does not have to know it is there; each disk only
+//	uses the first 1/N of its own sectors.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef STRIPEDVOLUME_H
+#define STRIPEDVOLUME_H
+
+#include "copyright.h"
+#include "diskarray.h"
+
+#define DefaultStripeUnit 8 // sectors per stripe unit
+
+// The following class defines a striped volume.
+
+class StripedVolume : public DiskArray
+{
+public:
+    StripedVolume(int numDisks, int stripeUnit, DiskPolicy policy,
+                  bool mapped, DiskModel model);
+    // Create "numDisks" disks, striped
+    //  "stripeUnit" sectors at a time;
+    //  the rest is as for DiskArray
+
+    void Submit(DiskRequest *request); // Split a request between the
+                                       //  disks, and start the pieces
+
+private:
+    int stripeUnit; // sectors per stripe unit
+};
+
+#endif // STRIPEDVOLUME_H
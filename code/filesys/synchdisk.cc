@@ -5,10 +5,23 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Requests are handed to the disk queue (or volume), together with
+//	an object whose CallBack is invoked as each one completes; a
+//	thread waits for its requests on a semaphore that the CallBack
+//	signals.  The lock only protects the block cache, and is not held
+//	while waiting for the disk, except while flushing.
+//
+//	Every sector read or written also goes into a block cache, and
+//	reads are satisfied from the cache when they can be.  Normally the
+//	cache is write-through, and the disk is always up to date.  In
+//	write-back mode, a write only dirties the cached copy; dirty
+//	sectors are written in sector order, neighbours together, by
+//	the flusher thread or by Sync.
+//
+//	A block being read into from disk is pinned and marked "filling".
+//	Anyone else who wants that sector meanwhile waits for the read to
+//	finish.  A write to it marks it "stale", so that it is dropped
+//	from the cache once the read finishes.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,33 +29,83 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "journal.h"
+#include "main.h"
+
+// Wakes a thread once all of a number of its disk requests are done.
+
+class RequestsDone : public CallBackObj {
+  public:
+    RequestsDone() { semaphore = new Semaphore("synch disk", 0); }
+    ~RequestsDone() { delete semaphore; }
+
+    void CallBack() { semaphore->V(); }	// one more request is done
+    void Wait(int numRequests) {	// wait for all of them
+	for (int i = 0; i < numRequests; i++)
+	    semaphore->P();
+    }
+
+  private:
+    Semaphore *semaphore;
+};
+
+// Finishes off the blocks of a prefetch, once all its requests are done.
 
+class PrefetchDone : public CallBackObj {
+  public:
+    PrefetchDone(SynchDisk *disk) { this->disk = disk; remaining = 0; }
+
+    void CallBack() {
+	if (--remaining > 0)
+	    return;
+	for (int i = 0; i < (int)blocks.size(); i++)
+	    disk->FinishFill(blocks[i]);
+	delete this;
+    }
+
+    vector<CachedBlock *> blocks;	// the blocks being read into
+    int remaining;			// requests not done yet
+
+  private:
+    SynchDisk *disk;
+};
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
-// 	Initialize the synchronous interface to the physical disk, in turn
-//	initializing the physical disk.
+// 	Initialize the synchronous interface to the physical disk, which
+//	is reached through a disk queue, or a volume of several disks.
 //
+//	"device" -- the disk queue or volume; deleted along with us
+//	"cacheSize" -- how many sectors to cache; zero turns the cache off
+//	"writeBack" -- if true, hold written sectors in the cache, and
+//		start a flusher thread to write them out
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk()
+SynchDisk::SynchDisk(BlockDevice *device, int cacheSize, bool writeBack)
 {
-    semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
-    disk = new Disk(this);
+    this->device = device;
+    cache = (cacheSize > 0) ? new BlockCache(cacheSize) : NULL;
+    this->cacheSize = cacheSize;
+    flusher = (cache != NULL && writeBack) ? new Flusher(this) : NULL;
+    highWater = cacheSize * 3 / 4;
+    journal = NULL;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::~SynchDisk
 // 	De-allocate data structures needed for the synchronous disk
-//	abstraction.
+//	abstraction.  The disk cannot be used while Nachos is halting, so
+//	dirty blocks are not flushed here; Kernel::Sync has flushed them
+//	before every halt (see Kernel::SyncBeforeHalt, and SysHalt).
 //----------------------------------------------------------------------
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
+    delete flusher;
+    delete cache;
+    delete device;
     delete lock;
-    delete semaphore;
 }
 
 //----------------------------------------------------------------------
@@ -57,10 +120,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    ReadSectors(vector<SectorBuffer>(1, SectorBuffer(sectorNumber, data)));
 }
 
 //----------------------------------------------------------------------
@@ -75,20 +135,405 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    WriteSectors(vector<SectorBuffer>(1, SectorBuffer(sectorNumber, data)));
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::RunLength
+// 	Return how many entries, starting at sectors[first], name
+//	consecutive disk sectors, and so can go to the disk together.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::RunLength(const vector<SectorBuffer> &sectors, int first)
+{
+    int last = first;
+
+    while (last + 1 < (int)sectors.size() 
+		&& sectors[last + 1].first == sectors[last].first + 1)
+	last++;
+    return last - first + 1;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::SubmitRuns
+// 	Queue a request for each run of consecutive sectors in a list,
+//	without waiting for any of them.  Return how many requests there
+//	were; "whenDone" is called as each of them completes.
+//
+//	"sectors" -- (sector, buffer) pairs
+//	"writing" -- write the buffers out, rather than read into them
+//	"whenDone" -- told about each completed request
+//----------------------------------------------------------------------
+
+int
+SynchDisk::SubmitRuns(const vector<SectorBuffer> &sectors, bool writing,
+		      CallBackObj *whenDone)
+{
+    vector<char *> buffers(sectors.size());
+    int i, count, numRequests = 0;
+
+    for (i = 0; i < (int)sectors.size(); i++)
+	buffers[i] = sectors[i].second;
+
+    for (i = 0; i < (int)sectors.size(); i += count, numRequests++) {
+	count = RunLength(sectors, i);
+	device->Submit(new DiskRequest(sectors[i].first, &buffers[i], count, 
+					 writing, whenDone));
+    }
+    return numRequests;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::FinishFill
+// 	A block has been read into from disk: unpin it, so that it can be
+//	used, or drop it if the sector was written meanwhile, and tell
+//	anyone waiting for it.  Called with the lock held, or from the
+//	disk interrupt handler.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::FinishFill(CachedBlock *block)
+{
+    block->filling = FALSE;
+    cache->Unpin(block);
+    if (block->stale)
+	cache->Invalidate(block);
+    for (int i = 0; i < (int)block->waiters.size(); i++)
+	block->waiters[i]->CallBack();
+    block->waiters.clear();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadSectors
+// 	Read a list of disk sectors, each into its own buffer.  Return
+//	only after all of them have been read.
+//
+//	Cached sectors are copied out of the cache.  The rest are read
+//	from the disk straight into newly allocated cache blocks, which
+//	stay pinned until they are filled in, and then copied out.  If
+//	there is no free cache block, the sector is read directly into the
+//	caller's buffer.  A sector that someone else is already reading
+//	(a prefetch, say) is waited for, and then copied out of the cache
+//	like any other; if it has already gone again, it is read afresh.
+//
+//	"sectors" -- (sector, buffer) pairs; no sector may appear twice
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadSectors(const vector<SectorBuffer> &sectors)
+{
+    vector<SectorBuffer> misses, waited, retry;
+    vector<CachedBlock *> filling;	// blocks being read into, and
+    vector<int> fillingFor;		//  which entry each one is for
+    RequestsDone done;
+    CachedBlock *block;
+    int i, numRequests;
+
+    lock->Acquire();
+    for (i = 0; i < (int)sectors.size(); i++) {
+	if (journal != NULL && journal->Lookup(sectors[i].first,
+					       sectors[i].second))
+	    continue;
+	if (cache == NULL) {
+	    misses.push_back(sectors[i]);
+	    continue;
+	}
+	block = cache->Find(sectors[i].first);
+	if (block != NULL && block->filling) {	// already on its way
+	    block->waiters.push_back(&done);
+	    waited.push_back(sectors[i]);
+	    continue;
+	}
+	if (block != NULL) {
+	    kernel->stats->numCacheHits++;
+	    if (block->readAhead) {
+		kernel->stats->numReadAheadHits++;
+		block->readAhead = FALSE;
+	    }
+	    bcopy(block->data, sectors[i].second, SectorSize);
+	    continue;
+	}
+	kernel->stats->numCacheMisses++;
+	block = cache->Allocate(sectors[i].first);
+	if (block == NULL) {		// no room: go around the cache
+	    misses.push_back(sectors[i]);
+	    continue;
+	}
+	cache->Pin(block);
+	block->filling = TRUE;
+	filling.push_back(block);
+	fillingFor.push_back(i);
+	misses.push_back(SectorBuffer(sectors[i].first, block->data));
+    }
+    numRequests = SubmitRuns(misses, FALSE, &done);
     lock->Release();
+
+    done.Wait(numRequests + waited.size());
+
+    // copy the newly cached sectors out to the caller, and the ones
+    // we waited for, if they are still there
+    if (filling.empty() && waited.empty())
+	return;
+    lock->Acquire();
+    for (i = 0; i < (int)filling.size(); i++) {
+	bcopy(filling[i]->data, sectors[fillingFor[i]].second, SectorSize);
+	FinishFill(filling[i]);
+    }
+    for (i = 0; i < (int)waited.size(); i++) {
+	block = cache->Find(waited[i].first);
+	if (block == NULL || block->filling) {
+	    retry.push_back(waited[i]);
+	    continue;
+	}
+	kernel->stats->numCacheHits++;
+	if (block->readAhead) {
+	    kernel->stats->numReadAheadHits++;
+	    block->readAhead = FALSE;
+	}
+	bcopy(block->data, waited[i].second, SectorSize);
+    }
+    lock->Release();
+    if (!retry.empty())
+	ReadSectors(retry);
 }
 
 //----------------------------------------------------------------------
-// SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// SynchDisk::WriteSectors
+// 	Write a list of buffers, each into its own disk sector.  The
+//	cached copy of each sector is brought up to date as well.
+//
+//	Normally, return only after all of them have been written.  In
+//	write-back mode, return as soon as they are in the cache; only a
+//	sector for which there is no clean block to spare goes to the disk
+//	now.  The flusher is woken at once if that leaves too many sectors
+//	dirty, and is otherwise set to run a little later.
+//
+//	The requests are queued before the lock is released, so that two
+//	writes to one sector reach the disk in the same order as they
+//	reached the cache.
+//
+//	A sector the journal wants goes to it instead, and the cached copy,
+//	if any, is kept clean, so that it does not reach the disk before
+//	the journal has committed it.  The journal is given what the
+//	sector held before, if the cache has it as it is on disk.
+//
+//	"sectors" -- (sector, buffer) pairs; no sector may appear twice
 //----------------------------------------------------------------------
 
 void
-SynchDisk::CallBack()
-{ 
-    semaphore->V();
+SynchDisk::WriteSectors(const vector<SectorBuffer> &sectors)
+{
+    vector<SectorBuffer> writeThrough;
+    RequestsDone done;
+    CachedBlock *block;
+    int numRequests;
+
+    lock->Acquire();
+    for (int i = 0; i < (int)sectors.size(); i++) {
+	if (journal != NULL && journal->Wants(sectors[i].first)) {
+	    Capture(sectors[i]);
+	    continue;
+	}
+	block = NULL;
+	if (cache != NULL) {
+	    block = cache->Find(sectors[i].first);
+	    if (block != NULL && block->filling) {	// old data on its way
+		block->stale = TRUE;
+		block = NULL;
+	    } else {
+		if (block == NULL)
+		    block = cache->Allocate(sectors[i].first);
+		if (block != NULL)
+		    bcopy(sectors[i].second, block->data, SectorSize);
+	    }
+	}
+	if (flusher != NULL && block != NULL)
+	    cache->MarkDirty(block);
+	else
+	    writeThrough.push_back(sectors[i]);
+    }
+    numRequests = SubmitRuns(writeThrough, TRUE, &done);
+
+    if (flusher != NULL) {
+	if (cache->NumDirty() >= highWater)
+	    flusher->Wake();
+	else if (cache->NumDirty() > 0)
+	    flusher->Schedule();
+    }
+    lock->Release();
+
+    done.Wait(numRequests);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Capture
+// 	Hand a sector being written to the journal, along with its old
+//	contents, if the cache has them clean, and bring the cached copy
+//	up to date without dirtying it.  Called with the lock held.
+//
+//	"sector" -- the sector and its new contents
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Capture(const SectorBuffer &sector)
+{
+    CachedBlock *block = (cache == NULL) ? NULL : cache->Find(sector.first);
+    char *base = NULL;
+
+    if (block != NULL && block->filling) {	// old data on its way
+	block->stale = TRUE;
+	block = NULL;
+    }
+    if (block != NULL && !block->dirty)
+	base = block->data;
+    journal->Capture(sector.first, base, sector.second);
+    if (block != NULL) {
+	bcopy(sector.second, block->data, SectorSize);
+	cache->MarkClean(block);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteThrough
+// 	Write a list of buffers, each into its own disk sector, straight
+//	to disk, bypassing the journal; the cached copy of each sector, if
+//	any, is brought up to date and left clean.  Return only after all
+//	of them have been written.
+//
+//	"sectors" -- (sector, buffer) pairs; no sector may appear twice
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteThrough(const vector<SectorBuffer> &sectors)
+{
+    RequestsDone done;
+    CachedBlock *block;
+    int numRequests;
+
+    lock->Acquire();
+    for (int i = 0; cache != NULL && i < (int)sectors.size(); i++) {
+	block = cache->Find(sectors[i].first);
+	if (block != NULL && block->filling)	// old data on its way
+	    block->stale = TRUE;
+	else if (block != NULL) {
+	    bcopy(sectors[i].second, block->data, SectorSize);
+	    cache->MarkClean(block);
+	}
+    }
+    numRequests = SubmitRuns(sectors, TRUE, &done);
+    lock->Release();
+
+    done.Wait(numRequests);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBack
+// 	Write every dirty sector in the cache to disk.  Return only after
+//	all of them have been written.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteBack()
+{
+    lock->Acquire();
+    Flush();
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sync
+// 	Write every dirty sector in the cache to disk, and then make sure
+//	that everything written to the disk has reached its UNIX file,
+//	which a mapped disk does not otherwise promise.  Return only once
+//	it has.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Sync()
+{
+    WriteBack();
+    device->Sync();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write every dirty sector in the cache to disk, in sector order, so
+//	that neighbouring dirty sectors go to the disk as one request.
+//	The blocks are pinned while they are being written.  The caller
+//	must hold the lock, and keeps it until the writes are done, so
+//	that nobody changes a block while it is on its way to disk.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    vector<CachedBlock *> dirty;
+    vector<SectorBuffer> sectors;
+    RequestsDone done;
+    int i;
+
+    if (cache == NULL || cache->NumDirty() == 0)
+	return;
+
+    dirty = cache->DirtyBlocks();
+    DEBUG(dbgDisk, "Flushing " << dirty.size() << " dirty sectors");
+    for (i = 0; i < (int)dirty.size(); i++) {
+	cache->Pin(dirty[i]);
+	sectors.push_back(SectorBuffer(dirty[i]->sector, dirty[i]->data));
+    }
+    done.Wait(SubmitRuns(sectors, TRUE, &done));
+    for (i = 0; i < (int)dirty.size(); i++) {
+	cache->MarkClean(dirty[i]);
+	cache->Unpin(dirty[i]);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Start reading a run of sectors into the cache, and return without
+//	waiting for them.  Sectors already cached, or held by the journal
+//	(which are newer than on disk), are skipped.  Nothing
+//	more is read once the cache has no unpinned clean block left.
+//
+//	"sectorNumber" -- the first sector to read
+//	"numSectors" -- how many consecutive sectors to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Prefetch(int sectorNumber, int numSectors)
+{
+    PrefetchDone *done;
+    vector<SectorBuffer> sectors;
+    CachedBlock *block;
+    IntStatus oldLevel;
+
+    if (cache == NULL)
+	return;
+
+    lock->Acquire();
+    done = new PrefetchDone(this);
+    for (int i = 0; i < numSectors; i++) {
+	if (cache->Find(sectorNumber + i) != NULL
+		|| (journal != NULL && journal->Holds(sectorNumber + i)))
+	    continue;
+	block = cache->Allocate(sectorNumber + i);
+	if (block == NULL)
+	    break;
+	cache->Pin(block);
+	block->filling = TRUE;
+	block->readAhead = TRUE;
+	done->blocks.push_back(block);
+	sectors.push_back(SectorBuffer(block->sector, block->data));
+	kernel->stats->numReadAheadSectors++;
+    }
+    if (sectors.empty())
+	delete done;
+    else {
+	// no request can finish until "remaining" is set
+	oldLevel = kernel->interrupt->SetLevel(IntOff);
+	done->remaining = SubmitRuns(sectors, FALSE, done);
+	kernel->interrupt->SetLevel(oldLevel);
+    }
+    lock->Release();
 }
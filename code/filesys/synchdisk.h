@@ -13,7 +13,15 @@
 
 #include "disk.h"
 #include "synch.h"
-#include "callback.h"
+#include "diskqueue.h"
+#include "blockcache.h"
+#include "flusher.h"
+#include <vector>
+
+class Journal;
+
+typedef pair<int, char *> SectorBuffer;	// a disk sector, and the buffer
+					// to transfer it to or from
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -24,32 +32,92 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests go to the disk through a disk queue, so several
+// threads can be waiting for the disk at once, and the queue decides
+// the order in which their requests are served.  The "disk" may also
+// be a volume made of several disks, each with its own queue.
+//
+// Sectors also pass through a block cache, so that a sector that was
+// recently read or written is not read from the disk again.  Normally
+// writes go straight through to the disk as well; in write-back mode
+// they only reach the cache, and a background flusher (or Sync) writes
+// them out later.
+//
+// Prefetch is the one asynchronous operation: it starts reading
+// sectors into the cache and returns at once.
+//
+// Once the file system attaches a journal, writes that are to be
+// logged go to the journal instead of the disk, and reads of a sector
+// the journal holds are served from it.
 
-class SynchDisk : public CallBackObj {
+class SynchDisk {
   public:
-    SynchDisk();    		        // Initialize a synchronous disk,
-					// by initializing the raw Disk.
+    SynchDisk(BlockDevice *device, int cacheSize, bool writeBack);
+    					// Initialize a synchronous disk
+					// over "device", which it then
+					// owns, with a cache of "cacheSize"
+					// sectors (none if zero)
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+					// or written.  
     void WriteSector(int sectorNumber, char* data);
-    
-    void CallBack();			// Called by the disk device interrupt
-					// handler, to signal that the
-					// current disk operation is complete.
+
+    void ReadSectors(const vector<SectorBuffer> &sectors);
+    void WriteSectors(const vector<SectorBuffer> &sectors);
+    					// Read/write a list of distinct
+					// sectors, each run of consecutive
+					// sectors that is not cached going
+					// to the disk as a single request.
+
+    void WriteThrough(const vector<SectorBuffer> &sectors);
+    					// Write a list of sectors straight
+					// to disk, even in write-back mode,
+					// and never to the journal
+
+    void WriteBack();			// Write every dirty cached sector
+					// to disk
+    void Sync();			// WriteBack, then make sure the
+					// disk's UNIX file is up to date
+
+    void Prefetch(int sectorNumber, int numSectors);
+    					// Start reading a run of sectors
+					// into the cache, without waiting
+    int CacheSize() { return cacheSize; }
+    					// Sectors the cache can hold
+    void AttachJournal(Journal *journal) { this->journal = journal; }
+    					// Log writes with "journal", or
+					// stop, if it is NULL
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    int RunLength(const vector<SectorBuffer> &sectors, int first);
+    					// Number of consecutive sectors
+					// starting at sectors[first]
+    int SubmitRuns(const vector<SectorBuffer> &sectors, bool writing,
+		   CallBackObj *whenDone);
+    					// Queue a list of sectors to be
+					// transferred, one request per run;
+					// return the number of requests
+    void Capture(const SectorBuffer &sector);
+    					// Hand a write to the journal
+    void FinishFill(CachedBlock *block);
+    					// A block has been read into
+    void Flush();			// WriteBack, with the lock already
+					// held
+
+    BlockDevice *device;		// The disk(s), and their queues
+    Lock *lock;		  		// Protects the cache
+    BlockCache *cache;			// Recently used sectors, or NULL
+    int cacheSize;			// How many sectors it holds
+    Flusher *flusher;			// Writes back dirty sectors; NULL
+					// unless in write-back mode
+    int highWater;			// Dirty sectors that wake the flusher
+    Journal *journal;			// Where logged writes go; NULL if
+					// there is no journal
+
+    friend class PrefetchDone;
 };
 
 #endif // SYNCHDISK_H
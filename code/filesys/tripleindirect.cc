@@ -9,11 +9,16 @@
 TripleIndirect::TripleIndirect()
 {
     memset(DISectors, -1, sizeof(DISectors));
+    table = NULL;
+    numDoubleIndirect = 0;
 }
 
-TripleIndirect::~TripleIndirect() {}
+TripleIndirect::~TripleIndirect()
+{
+    delete[] table;
+}
 
-bool TripleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount)
+bool TripleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount, int *goal)
 {
     int numSectors = sectorAmount;
 
@@ -23,13 +28,7 @@ bool TripleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount)
         return FALSE; // not enough space
 
     // for original inode
-    for (int i = 0; i < numDoubleIndirect; i++)
-    {
-        DISectors[i] = freeMap->FindAndSet();
-        // since we checked that there was enough free space,
-        // we expect this to succeed
-        ASSERT(DISectors[i] >= 0);
-    }
+    *goal = freeMap->AllocateSectors(DISectors, numDoubleIndirect, *goal);
 
     // for DoubleIndirect
     if (numDoubleIndirect)
@@ -37,9 +36,9 @@ bool TripleIndirect::Allocate(PersistentBitmap *freeMap, int sectorAmount)
     for (int i = 0; i < numDoubleIndirect; i++)
     {
         if (numSectors > DISize)
-            table[i].Allocate(freeMap, DISize);
+            table[i].Allocate(freeMap, DISize, goal);
         else
-            table[i].Allocate(freeMap, numSectors);
+            table[i].Allocate(freeMap, numSectors, goal);
 
         numSectors = numSectors - DISize;
     }
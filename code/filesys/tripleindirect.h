@@ -10,9 +10,10 @@ public:
     TripleIndirect();
     ~TripleIndirect();
 
-    bool Allocate(PersistentBitmap *bitMap, int sectorAmount); // Initialize a file header,
-                                                               //  including allocating space
-                                                               //  on disk for the file data
+    bool Allocate(PersistentBitmap *bitMap, int sectorAmount, int *goal); // Initialize a file header,
+                                                                          //  including allocating space
+                                                                          //  on disk for the file data,
+                                                                          //  as near "goal" as possible
     void Deallocate(PersistentBitmap *bitMap);                 // De-allocate this file's
                                                                //  data blocks
 
@@ -10,6 +10,24 @@
 #include "debug.h"
 #include "bitmap.h"
 
+//----------------------------------------------------------------------
+// CountTrailingZeros, CountOnes
+//	Word-at-a-time helpers used to search and count the bitmap.
+//	"word" passed to CountTrailingZeros must be non-zero.
+//----------------------------------------------------------------------
+
+static inline int
+CountTrailingZeros(unsigned int word)
+{
+    return __builtin_ctz(word);
+}
+
+static inline int
+CountOnes(unsigned int word)
+{
+    return __builtin_popcount(word);
+}
+
 //----------------------------------------------------------------------
 // BitMap::BitMap
 // 	Initialize a bitmap with "numItems" bits, so that every bit is clear.
@@ -30,9 +48,9 @@ Bitmap::Bitmap(int numItems)
     for (i = 0; i < numWords; i++) {
 	map[i] = 0;		// initialize map to keep Purify happy
     }
-    for (i = 0; i < numBits; i++) {
-        Clear(i);
-    }
+    numSummaryWords = divRoundUp(numWords, BitsInWord);
+    summary = new unsigned int[numSummaryWords];
+    Recount();
 }
 
 //----------------------------------------------------------------------
@@ -43,6 +61,50 @@ Bitmap::Bitmap(int numItems)
 Bitmap::~Bitmap()
 { 
     delete [] map;
+    delete [] summary;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::ValidBits
+// 	Return a mask of the bits in word "word" of the map that stand
+//	for items in the bitmap.  Only the last word can be partial.
+//----------------------------------------------------------------------
+
+unsigned int
+Bitmap::ValidBits(int word) const
+{
+    int bits = numBits - word * BitsInWord;
+
+    if (bits >= BitsInWord) {
+	return ~0u;
+    }
+    return (1u << bits) - 1;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::Recount
+// 	Rebuild the cached clear count and the summary level from the
+//	contents of "map".  Needed whenever "map" is filled in directly,
+//	for instance when a persistent bitmap is read off of disk.
+//----------------------------------------------------------------------
+
+void
+Bitmap::Recount()
+{
+    int i;
+
+    numClear = 0;
+    for (i = 0; i < numSummaryWords; i++) {
+	summary[i] = 0;
+    }
+    for (i = 0; i < numWords; i++) {
+	unsigned int clear = ~map[i] & ValidBits(i);
+
+	if (clear != 0) {
+	    numClear += CountOnes(clear);
+	    summary[i / BitsInWord] |= 1u << (i % BitsInWord);
+	}
+    }
 }
 
 //----------------------------------------------------------------------
@@ -55,9 +117,18 @@ Bitmap::~Bitmap()
 void
 Bitmap::Mark(int which) 
 { 
+    int word = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    if (!(map[word] & bit)) {
+	map[word] |= bit;
+	numClear--;
+	if ((~map[word] & ValidBits(word)) == 0) {	// word is now full
+	    summary[word / BitsInWord] &= ~(1u << (word % BitsInWord));
+	}
+    }
 
     ASSERT(Test(which));
 }
@@ -72,9 +143,16 @@ Bitmap::Mark(int which)
 void 
 Bitmap::Clear(int which) 
 {
+    int word = which / BitsInWord;
+    unsigned int bit = 1u << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
 
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (map[word] & bit) {
+	map[word] &= ~bit;
+	numClear++;
+	summary[word / BitsInWord] |= 1u << (word % BitsInWord);
+    }
 
     ASSERT(!Test(which));
 }
@@ -91,13 +169,66 @@ Bitmap::Test(int which) const
 {
     ASSERT(which >= 0 && which < numBits);
     
-    if (map[which / BitsInWord] & (1 << (which % BitsInWord))) {
+    if (map[which / BitsInWord] & (1u << (which % BitsInWord))) {
 	return TRUE;
     } else {
 	return FALSE;
     }
 }
 
+//----------------------------------------------------------------------
+// Bitmap::FindClear
+// 	Return the number of the first clear bit at or after "start",
+//	without changing the bitmap.  If there is none, return -1.
+//
+//	The word holding "start" is checked directly; after that, the
+//	summary level tells us which words have a clear bit, so full
+//	words are skipped 32 at a time.
+//
+//	"start" is the number of the first bit to consider.
+//----------------------------------------------------------------------
+
+int
+Bitmap::FindClear(int start) const
+{
+    int word, sword;
+    unsigned int clear, pending;
+
+    if (start < 0) {
+	start = 0;
+    }
+    if (start >= numBits || numClear == 0) {
+	return -1;
+    }
+
+    // first, the (possibly partial) word containing "start"
+    word = start / BitsInWord;
+    clear = ~map[word] & ValidBits(word) & (~0u << (start % BitsInWord));
+    if (clear != 0) {
+	return word * BitsInWord + CountTrailingZeros(clear);
+    }
+
+    // then, any word after it with a clear bit, found through the summary
+    word++;
+    if (word >= numWords) {
+	return -1;
+    }
+    sword = word / BitsInWord;
+    pending = summary[sword] & (~0u << (word % BitsInWord));
+    for (;;) {
+	if (pending != 0) {
+	    word = sword * BitsInWord + CountTrailingZeros(pending);
+	    clear = ~map[word] & ValidBits(word);
+	    ASSERT(clear != 0);
+	    return word * BitsInWord + CountTrailingZeros(clear);
+	}
+	if (++sword >= numSummaryWords) {
+	    return -1;
+	}
+	pending = summary[sword];
+    }
+}
+
 //----------------------------------------------------------------------
 // Bitmap::FindAndSet
 // 	Return the number of the first bit which is clear.
@@ -110,32 +241,26 @@ Bitmap::Test(int which) const
 int 
 Bitmap::FindAndSet() 
 {
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
-	}
+    int which = FindClear(0);
+
+    if (which >= 0) {
+	Mark(which);
     }
-    return -1;
+    return which;
 }
 
 //----------------------------------------------------------------------
 // Bitmap::NumClear
 // 	Return the number of clear bits in the bitmap.
 //	(In other words, how many bits are unallocated?)
+//
+//	The count is maintained by Mark and Clear, so this is constant time.
 //----------------------------------------------------------------------
 
 int 
 Bitmap::NumClear() const
 {
-    int count = 0;
-
-    for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    count++;
-	}
-    }
-    return count;
+    return numClear;
 }
 
 //----------------------------------------------------------------------
@@ -177,15 +302,31 @@ Bitmap::SelfTest()
     ASSERT(Test(0) && Test(31));
 
     ASSERT(FindAndSet() == 1);
+    ASSERT(NumClear() == numBits - 3);
+    Mark(31);				// marking twice changes nothing
+    ASSERT(NumClear() == numBits - 3);
     Clear(0);
     Clear(1);
     Clear(31);
+    ASSERT(NumClear() == numBits);
 
     for (i = 0; i < numBits; i++) {
         Mark(i);
     }
+    ASSERT(NumClear() == 0);
     ASSERT(FindAndSet() == -1);		// bitmap should be full!
+
+    Clear(numBits - 1);			// search must skip the full words
+    ASSERT(FindClear(0) == numBits - 1);
+    ASSERT(FindAndSet() == numBits - 1);
+    if (numBits > BitsInWord + 4) {
+	Clear(BitsInWord + 3);
+	ASSERT(FindClear(BitsInWord + 4) == -1);
+	ASSERT(FindClear(1) == BitsInWord + 3);
+    }
+
     for (i = 0; i < numBits; i++) {
         Clear(i);
     }
+    ASSERT(NumClear() == numBits);
 }
@@ -5,6 +5,13 @@
 //	Represented as an array of unsigned integers, on which we do
 //	modulo arithmetic to find the bit we are interested in.
 //
+//	To keep searches cheap on large bitmaps (eg, the 512K sector
+//	free map), we also keep a running count of the clear bits, and
+//	a second, smaller level of bits -- one per word of storage --
+//	recording which words still have at least one clear bit.
+//	Searching scans a word at a time, using count-trailing-zeros
+//	to pick out the bit, instead of testing one bit at a time.
+//
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
 //
@@ -42,6 +49,8 @@ class Bitmap {
     int FindAndSet();         // Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindClear(int start) const; // Return the # of the first clear bit
+				// at or after "start", or -1 if none
     int NumClear() const;	// Return the number of clear bits
 
     void Print() const;		// Print contents of bitmap
@@ -54,6 +63,18 @@ class Bitmap {
 				//  multiple of the number of bits in
 				//  a word)
     unsigned int *map;		// bit storage
+
+    int numClear;		// number of clear bits, kept up to date
+				// by Mark and Clear
+    int numSummaryWords;	// number of words of summary storage
+    unsigned int *summary;	// bit "w" is set iff word "w" of map
+				// has at least one clear bit
+
+    unsigned int ValidBits(int word) const;
+				// mask of the bits in "word" that are
+				// part of the bitmap
+    void Recount();		// recompute numClear and summary after
+				// "map" has been overwritten in bulk
 };
 
 #endif // BITMAP_H
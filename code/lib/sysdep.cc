@@ -32,6 +32,9 @@
 #include <sys/file.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <limits.h>
 #include <cerrno>
 
 #ifdef SOLARIS
@@ -367,6 +370,91 @@ WriteFile(int fd, char *buffer, int nBytes)
     ASSERT(retVal == nBytes);
 }
 
+//----------------------------------------------------------------------
+// ReadScatter/WriteGather
+// 	Read/write "numBuffers" buffers of "bufferSize" bytes each, which
+//	are consecutive in the file starting at "offset", with as few
+//	system calls as possible.  Does not change the file position.
+//	Abort if the transfer fails.
+//----------------------------------------------------------------------
+
+void
+ReadScatter(int fd, char **buffers, int numBuffers, int bufferSize, int offset)
+{
+    struct iovec iov[IOV_MAX];
+
+    while (numBuffers > 0) {
+	int n = (numBuffers < IOV_MAX) ? numBuffers : IOV_MAX;
+	for (int i = 0; i < n; i++) {
+	    iov[i].iov_base = buffers[i];
+	    iov[i].iov_len = bufferSize;
+	}
+	int retVal = preadv(fd, iov, n, offset);
+	ASSERT(retVal == n * bufferSize);
+	buffers += n;
+	numBuffers -= n;
+	offset += n * bufferSize;
+    }
+}
+
+void
+WriteGather(int fd, char **buffers, int numBuffers, int bufferSize, int offset)
+{
+    struct iovec iov[IOV_MAX];
+
+    while (numBuffers > 0) {
+	int n = (numBuffers < IOV_MAX) ? numBuffers : IOV_MAX;
+	for (int i = 0; i < n; i++) {
+	    iov[i].iov_base = buffers[i];
+	    iov[i].iov_len = bufferSize;
+	}
+	int retVal = pwritev(fd, iov, n, offset);
+	ASSERT(retVal == n * bufferSize);
+	buffers += n;
+	numBuffers -= n;
+	offset += n * bufferSize;
+    }
+}
+
+//----------------------------------------------------------------------
+// MapFile
+// 	Map the first "size" bytes of an open file into memory, shared,
+//	so that stores to the mapping change the file.  Abort on error.
+//----------------------------------------------------------------------
+
+char *
+MapFile(int fd, int size)
+{
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ASSERT(addr != MAP_FAILED);
+    return (char *) addr;
+}
+
+//----------------------------------------------------------------------
+// SyncMappedFile
+// 	Write any changes made through a mapping back to the file, and
+//	return only once they are there.  Abort on error.
+//----------------------------------------------------------------------
+
+void
+SyncMappedFile(char *addr, int size)
+{
+    int retVal = msync(addr, size, MS_SYNC);
+    ASSERT(retVal == 0);
+}
+
+//----------------------------------------------------------------------
+// UnmapFile
+// 	Remove a mapping made by MapFile.  Abort on error.
+//----------------------------------------------------------------------
+
+void
+UnmapFile(char *addr, int size)
+{
+    int retVal = munmap(addr, size);
+    ASSERT(retVal == 0);
+}
+
 //----------------------------------------------------------------------
 // Lseek
 // 	Change the location within an open file.  Abort on error.
@@ -48,6 +48,11 @@ extern int OpenForReadWrite(char *name, bool crashOnError);
 extern void Read(int fd, char *buffer, int nBytes);
 extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, char *buffer, int nBytes);
+extern void ReadScatter(int fd, char **buffers, int numBuffers, int bufferSize, int offset);
+extern void WriteGather(int fd, char **buffers, int numBuffers, int bufferSize, int offset);
+extern char *MapFile(int fd, int size);
+extern void SyncMappedFile(char *addr, int size);
+extern void UnmapFile(char *addr, int size);
 extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern int Close(int fd);
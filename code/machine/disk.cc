@@ -35,20 +35,28 @@ const int DiskSize = (MagicSize + (NumSectors * SectorSize));
 // 	ok to treat it as Nachos disk storage.
 //
 //	"toCall" -- object to call when disk read/write request completes
+//	"mapped" -- map the UNIX file into memory, and copy sectors to and
+//		from the mapping, rather than reading and writing the file
+//	"model" -- how long requests take
+//	"member" -- which disk of an array this is, or -1 if it is the
+//		only one
 //----------------------------------------------------------------------
 
-Disk::Disk(CallBackObj *toCall)
+Disk::Disk(CallBackObj *toCall, bool mapped, DiskModel model, int member)
 {
     int magicNum;
     int tmp = 0;
 
     DEBUG(dbgDisk, "Initializing the disk.");
     callWhenDone = toCall;
-    lastSector = 0;
-    bufferInit = 0;
+    timing = DiskTiming::Create(model);
     
-    sprintf(diskname,"DISK_%d",kernel->hostName);
+    if (member < 0)
+	sprintf(diskname,"DISK_%d",kernel->hostName);
+    else
+	sprintf(diskname,"DISK_%d%c",kernel->hostName,'a' + member);
     fileno = OpenForReadWrite(diskname, FALSE);
+    created = (fileno < 0);
     if (fileno >= 0) {		 	// file exists, check magic number 
 	Read(fileno, (char *) &magicNum, MagicSize);
 	ASSERT(magicNum == MagicNumber);
@@ -61,18 +69,40 @@ Disk::Disk(CallBackObj *toCall)
         Lseek(fileno, DiskSize - sizeof(int), 0);	
 	WriteFile(fileno, (char *)&tmp, sizeof(int));  
     }
+    contents = mapped ? MapFile(fileno, DiskSize) : NULL;
     active = FALSE;
 }
 
 //----------------------------------------------------------------------
 // Disk::~Disk()
 // 	Clean up disk simulation, by closing the UNIX file representing the
-//	disk.
+//	disk.  A mapped file is synced and unmapped first.
 //----------------------------------------------------------------------
 
 Disk::~Disk()
 {
+    if (contents != NULL) {
+	SyncMappedFile(contents, DiskSize);
+	UnmapFile(contents, DiskSize);
+    }
     Close(fileno);
+    delete timing;
+}
+
+//----------------------------------------------------------------------
+// Disk::Sync()
+// 	Make sure that every sector written so far has reached the UNIX
+//	file.  Only a mapped disk has anything to do: each request to an
+//	unmapped one goes to the file as it is made.
+//----------------------------------------------------------------------
+
+void
+Disk::Sync()
+{
+    if (contents != NULL) {
+	DEBUG(dbgDisk, "Syncing the mapped disk.");
+	SyncMappedFile(contents, DiskSize);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -113,40 +143,82 @@ PrintSector (bool writing, int sector, char *data)
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadRequest(sectorNumber, &data, 1);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteRequest(sectorNumber, &data, 1);
+}
+
+//----------------------------------------------------------------------
+// Disk::ReadRequest/WriteRequest
+// 	Simulate a request to read/write a run of consecutive disk
+//	sectors.  The run is transferred with one host system call (or,
+//	on a mapped disk, a memory copy per sector), is charged one seek
+//	followed by a streaming transfer, and completes with a single
+//	interrupt.
+//
+//	"sectorNumber" -- the first disk sector to read/write
+//	"data" -- data[i] holds the bytes to be written to, or is the
+//		buffer to hold the incoming bytes of, sector sectorNumber + i
+//	"numSectors" -- the number of sectors in the run
+//----------------------------------------------------------------------
+
+void
+Disk::ReadRequest(int sectorNumber, char** data, int numSectors)
+{
+    int ticks = ComputeLatency(sectorNumber, FALSE, numSectors);
 
     ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+		&& (sectorNumber + numSectors <= NumSectors));
     
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Reading from sector " << sectorNumber << ", " << numSectors << " sectors");
+    if (contents != NULL)
+	for (int i = 0; i < numSectors; i++)
+	    bcopy(contents + SectorSize * (sectorNumber + i) + MagicSize,
+		  data[i], SectorSize);
+    else
+	ReadScatter(fileno, data, numSectors, SectorSize, 
+		    SectorSize * sectorNumber + MagicSize);
     if (debug->IsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(FALSE, sectorNumber + i, data[i]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
-    kernel->stats->numDiskReads++;
+    timing->Start(sectorNumber, FALSE, numSectors);
+    kernel->stats->numDiskReads += numSectors;
+    kernel->stats->diskBusyTicks += ticks;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, char** data, int numSectors)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
+    int ticks = ComputeLatency(sectorNumber, TRUE, numSectors);
 
     ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+		&& (sectorNumber + numSectors <= NumSectors));
     
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Writing to sector " << sectorNumber << ", " << numSectors << " sectors");
+    if (contents != NULL)
+	for (int i = 0; i < numSectors; i++)
+	    bcopy(data[i], contents + SectorSize * (sectorNumber + i) + MagicSize,
+		  SectorSize);
+    else
+	WriteGather(fileno, data, numSectors, SectorSize, 
+		    SectorSize * sectorNumber + MagicSize);
     if (debug->IsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(TRUE, sectorNumber + i, data[i]);
     
     active = TRUE;
-    UpdateLast(sectorNumber);
-    kernel->stats->numDiskWrites++;
+    timing->Start(sectorNumber, TRUE, numSectors);
+    kernel->stats->numDiskWrites += numSectors;
+    kernel->stats->diskBusyTicks += ticks;
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
@@ -162,107 +234,14 @@ Disk::CallBack ()
     callWhenDone->CallBack();
 }
 
-//----------------------------------------------------------------------
-// Disk::TimeToSeek()
-//	Returns how long it will take to position the disk head over the correct
-//	track on the disk.  Since when we finish seeking, we are likely
-//	to be in the middle of a sector that is rotating past the head,
-//	we also return how long until the head is at the next sector boundary.
-//	
-//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
-//----------------------------------------------------------------------
-
-int
-Disk::TimeToSeek(int newSector, int *rotation) 
-{
-    int newTrack = newSector / SectorsPerTrack;
-    int oldTrack = lastSector / SectorsPerTrack;
-    int seek = abs(newTrack - oldTrack) * SeekTime;
-				// how long will seek take?
-    int over = (kernel->stats->totalTicks + seek) % RotationTime; 
-				// will we be in the middle of a sector when
-				// we finish the seek?
-
-    *rotation = 0;
-    if (over > 0)	 	// if so, need to round up to next full sector
-   	*rotation = RotationTime - over;
-    return seek;
-}
-
-//----------------------------------------------------------------------
-// Disk::ModuloDiff()
-// 	Return number of sectors of rotational delay between target sector
-//	"to" and current sector position "from"
-//----------------------------------------------------------------------
-
-int 
-Disk::ModuloDiff(int to, int from)
-{
-    int toOffset = to % SectorsPerTrack;
-    int fromOffset = from % SectorsPerTrack;
-
-    return ((toOffset - fromOffset) + SectorsPerTrack) % SectorsPerTrack;
-}
-
 //----------------------------------------------------------------------
 // Disk::ComputeLatency()
-// 	Return how long will it take to read/write a disk sector, from
-//	the current position of the disk head.
-//
-//   	Latency = seek time + rotational latency + transfer time
-//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
-//   	and rotates at one sector per RotationTime ticks
-//
-//   	To find the rotational latency, we first must figure out where the 
-//   	disk head will be after the seek (if any).  We then figure out
-//   	how long it will take to rotate completely past newSector after 
-//	that point.
-//
-//   	The disk also has a "track buffer"; the disk continuously reads
-//   	the contents of the current disk track into the buffer.  This allows 
-//   	read requests to the current track to be satisfied more quickly.
-//   	The contents of the track buffer are discarded after every seek to 
-//   	a new track.
+// 	Return how long a request to read/write a run of sectors would
+//	take, if it started now.  The timing model decides.
 //----------------------------------------------------------------------
 
 int
-Disk::ComputeLatency(int newSector, bool writing)
-{
-    int rotation;
-    int seek = TimeToSeek(newSector, &rotation);
-    int timeAfter = kernel->stats->totalTicks + seek + rotation;
-
-#ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
-    // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0) 
-		&& (((timeAfter - bufferInit) / RotationTime) 
-	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
-        DEBUG(dbgDisk, "Request latency = " << RotationTime);
-	return RotationTime; // time to transfer sector from the track buffer
-    }
-#endif
-
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
-
-    DEBUG(dbgDisk, "Request latency = " << (seek + rotation + RotationTime));
-    return(seek + rotation + RotationTime);
-}
-
-//----------------------------------------------------------------------
-// Disk::UpdateLast
-//   	Keep track of the most recently requested sector.  So we can know
-//	what is in the track buffer.
-//----------------------------------------------------------------------
-
-void
-Disk::UpdateLast(int newSector)
+Disk::ComputeLatency(int newSector, bool writing, int numSectors)
 {
-    int rotate;
-    int seek = TimeToSeek(newSector, &rotate);
-    
-    if (seek != 0)
-	bufferInit = kernel->stats->totalTicks + seek + rotate;
-    lastSector = newSector;
-    DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
+    return timing->Latency(newSector, writing, numSectors);
 }
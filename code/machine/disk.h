@@ -1,6 +1,7 @@
 // disk.h
 //	Data structures to emulate a physical disk.  A physical disk
-//	can accept (one at a time) requests to read/write a disk sector;
+//	can accept (one at a time) requests to read/write a disk sector,
+//	or a run of consecutive sectors;
 //	when the request is satisfied, the CPU gets an interrupt, and
 //	the next request can be sent to the disk.
 //
@@ -20,6 +21,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "disktiming.h"
 
 // The following class defines a physical disk I/O device.  The disk
 // has a single surface, split up into "tracks", and each track split
@@ -46,6 +48,16 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// That is how the disk behaves by default.  The time a request takes
+// actually comes from a timing model (see disktiming.h), which may
+// instead simulate flash storage, or no delay at all.
+//
+// The UNIX file can either be read and written with a system call per
+// request, or mapped into memory, in which case each request is just
+// a memory copy.  A mapped disk only reaches the file for certain when
+// Sync is called, or when the disk is deleted.  The choice makes no
+// difference to the simulated time a request takes.
 
 #define NumDirEntries 64
 const int SectorSize = 128;     // number of bytes per disk sector
@@ -57,9 +69,16 @@ const int NumSectors = (SectorsPerTrack * NumTracks);
 class Disk : public CallBackObj
 {
 public:
-    Disk(CallBackObj *toCall); // Create a simulated disk.
-                               // Invoke toCall->CallBack()
-                               // when each request completes.
+    Disk(CallBackObj *toCall, bool mapped = FALSE, DiskModel model = HDD,
+         int member = -1);
+    // Create a simulated disk.
+    // Invoke toCall->CallBack()
+    // when each request completes.
+    // If "mapped", map the UNIX file
+    // into memory.  "model" decides
+    // how long requests take.  If the
+    // disk is "member" N of an array,
+    // its file is DISK_<host><'a'+N>.
     ~Disk();                   // Deallocate the disk.
 
     void ReadRequest(int sectorNumber, char *data);
@@ -69,26 +88,38 @@ public:
     // Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char *data);
 
+    void ReadRequest(int sectorNumber, char **data, int numSectors);
+    // Read/write "numSectors" consecutive
+    // sectors, starting at "sectorNumber",
+    // as a single request: data[i] is the
+    // buffer for the i'th sector.
+    void WriteRequest(int sectorNumber, char **data, int numSectors);
+
+    void Sync(); // Make sure everything written so
+                 // far is in the UNIX file.
+
+    bool Created() { return created; }
+    // Was the UNIX file created,
+    // rather than already there?
+
     void CallBack(); // Invoked when disk request
                      // finishes. In turn calls, callWhenDone.
 
-    int ComputeLatency(int newSector, bool writing);
+    int ComputeLatency(int newSector, bool writing, int numSectors = 1);
     // Return how long a request to
-    // newSector will take:
-    // (seek + rotational delay + transfer)
+    // newSector will take, if it
+    // started now (for a rotating disk:
+    // seek + rotational delay + transfer)
 
 private:
     int fileno;                // UNIX file number for simulated disk
     char diskname[32];         // name of simulated disk's file
+    bool created;              // did we create the file?
+    char *contents;            // the file, mapped into memory, or NULL
+                               // if it is read and written instead
     CallBackObj *callWhenDone; // Invoke when any disk request finishes
     bool active;               // Is a disk operation in progress?
-    int lastSector;            // The previous disk request
-    int bufferInit;            // When the track buffer started
-                               // being loaded
-
-    int TimeToSeek(int newSector, int *rotate); // time to get to the new track
-    int ModuloDiff(int to, int from);           // # sectors between to and from
-    void UpdateLast(int newSector);
+    DiskTiming *timing;        // How long requests take
 };
 
 #endif // DISK_H
@@ -0,0 +1,227 @@
+// disktiming.cc
+//	Routines to model how long the simulated disk takes to serve a
+//	request.  See disktiming.h for the models, and disk.h for the
+//	rotating disk that the HDD model simulates.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "disktiming.h"
+#include "disk.h"
+#include "debug.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// DiskTiming::Create
+// 	Make a timing model of the given kind.
+//----------------------------------------------------------------------
+
+DiskTiming *
+DiskTiming::Create(DiskModel model)
+{
+    switch (model) {
+      case HDD:
+	return new HDDTiming();
+      case SSD:
+	return new SSDTiming();
+      case Untimed:
+	return new UntimedTiming();
+    }
+    ASSERTNOTREACHED();
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// DiskTiming::ParseModel
+// 	Look up a timing model by name.  Return FALSE if there is no such
+//	model.
+//
+//	"name" -- one of "hdd", "ssd" or "none"
+//	"model" -- where to put the model
+//----------------------------------------------------------------------
+
+bool
+DiskTiming::ParseModel(char *name, DiskModel *model)
+{
+    if (strcmp(name, "hdd") == 0)
+	*model = HDD;
+    else if (strcmp(name, "ssd") == 0)
+	*model = SSD;
+    else if (strcmp(name, "none") == 0)
+	*model = Untimed;
+    else
+	return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// HDDTiming::HDDTiming
+// 	Start with the head over sector 0, and an empty track buffer.
+//----------------------------------------------------------------------
+
+HDDTiming::HDDTiming()
+{
+    lastSector = 0;
+    bufferInit = 0;
+}
+
+//----------------------------------------------------------------------
+// HDDTiming::Start
+// 	A request is starting: the head ends up over its last sector.
+//----------------------------------------------------------------------
+
+void
+HDDTiming::Start(int newSector, bool writing, int numSectors)
+{
+    UpdateLast(newSector + numSectors - 1);
+}
+
+//----------------------------------------------------------------------
+// HDDTiming::TimeToSeek()
+//	Returns how long it will take to position the disk head over the correct
+//	track on the disk.  Since when we finish seeking, we are likely
+//	to be in the middle of a sector that is rotating past the head,
+//	we also return how long until the head is at the next sector boundary.
+//
+//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
+//   	and rotates at one sector per RotationTime ticks
+//----------------------------------------------------------------------
+
+int
+HDDTiming::TimeToSeek(int newSector, int *rotation)
+{
+    int newTrack = newSector / SectorsPerTrack;
+    int oldTrack = lastSector / SectorsPerTrack;
+    int seek = abs(newTrack - oldTrack) * SeekTime;
+				// how long will seek take?
+    int over = (kernel->stats->totalTicks + seek) % RotationTime;
+				// will we be in the middle of a sector when
+				// we finish the seek?
+
+    *rotation = 0;
+    if (over > 0)	 	// if so, need to round up to next full sector
+   	*rotation = RotationTime - over;
+    return seek;
+}
+
+//----------------------------------------------------------------------
+// HDDTiming::ModuloDiff()
+// 	Return number of sectors of rotational delay between target sector
+//	"to" and current sector position "from"
+//----------------------------------------------------------------------
+
+int
+HDDTiming::ModuloDiff(int to, int from)
+{
+    int toOffset = to % SectorsPerTrack;
+    int fromOffset = from % SectorsPerTrack;
+
+    return ((toOffset - fromOffset) + SectorsPerTrack) % SectorsPerTrack;
+}
+
+//----------------------------------------------------------------------
+// HDDTiming::Latency()
+// 	Return how long will it take to read/write a disk sector, from
+//	the current position of the disk head.
+//
+//   	Latency = seek time + rotational latency + transfer time
+//   	Disk seeks at one track per SeekTime ticks (cf. stats.h)
+//   	and rotates at one sector per RotationTime ticks
+//
+//   	To find the rotational latency, we first must figure out where the
+//   	disk head will be after the seek (if any).  We then figure out
+//   	how long it will take to rotate completely past newSector after
+//	that point.
+//
+//   	The disk also has a "track buffer"; the disk continuously reads
+//   	the contents of the current disk track into the buffer.  This allows
+//   	read requests to the current track to be satisfied more quickly.
+//   	The contents of the track buffer are discarded after every seek to
+//   	a new track.
+//
+//	For a run of "numSectors" consecutive sectors, once the first one
+//	has been transferred the rest stream past the head at one sector
+//	per RotationTime, plus a one track seek wherever the run crosses
+//	onto the next track.
+//----------------------------------------------------------------------
+
+int
+HDDTiming::Latency(int newSector, bool writing, int numSectors)
+{
+    int rotation;
+    int seek = TimeToSeek(newSector, &rotation);
+    int timeAfter = kernel->stats->totalTicks + seek + rotation;
+    int endSector = newSector + numSectors - 1;
+    int stream = (numSectors - 1) * RotationTime
+		+ (endSector / SectorsPerTrack - newSector / SectorsPerTrack) * SeekTime;
+
+#ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
+    // check if track buffer applies
+    if ((writing == FALSE) && (seek == 0)
+		&& (((timeAfter - bufferInit) / RotationTime)
+	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
+        DEBUG(dbgDisk, "Request latency = " << RotationTime + stream);
+	return RotationTime + stream; // time to transfer sector from the track buffer
+    }
+#endif
+
+    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+
+    DEBUG(dbgDisk, "Request latency = " << (seek + rotation + RotationTime + stream));
+    return(seek + rotation + RotationTime + stream);
+}
+
+//----------------------------------------------------------------------
+// HDDTiming::UpdateLast
+//   	Keep track of the most recently requested sector.  So we can know
+//	what is in the track buffer.
+//----------------------------------------------------------------------
+
+void
+HDDTiming::UpdateLast(int newSector)
+{
+    int rotate;
+    int seek = TimeToSeek(newSector, &rotate);
+
+    if (seek != 0)
+	bufferInit = kernel->stats->totalTicks + seek + rotate;
+    lastSector = newSector;
+    DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
+}
+
+//----------------------------------------------------------------------
+// SSDTiming::Latency()
+// 	Return how long it will take to read/write a run of sectors on
+//	flash.  There is no seek or rotation: where the last request was
+//	makes no difference.  Flash is read and programmed a whole page
+//	(FlashPageSectors sectors) at a time, so every page the run
+//	touches costs FlashReadTime to read, or FlashProgramTime to
+//	program.  A write that covers only part of a page must read the
+//	rest of it first, so a page partly written also costs a read.
+//----------------------------------------------------------------------
+
+int
+SSDTiming::Latency(int newSector, bool writing, int numSectors)
+{
+    int endSector = newSector + numSectors;	// one past the run
+    int firstPage = newSector / FlashPageSectors;
+    int lastPage = (endSector - 1) / FlashPageSectors;
+    int numPages = lastPage - firstPage + 1;
+    int partial = 0;				// pages partly written
+    int latency;
+
+    if (!writing)
+	latency = numPages * FlashReadTime;
+    else {
+	if (newSector % FlashPageSectors != 0)
+	    partial++;
+	if (endSector % FlashPageSectors != 0
+		&& (lastPage != firstPage || partial == 0))
+	    partial++;
+	latency = numPages * FlashProgramTime + partial * FlashReadTime;
+    }
+    DEBUG(dbgDisk, "Request latency = " << latency);
+    return latency;
+}
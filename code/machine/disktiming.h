@@ -0,0 +1,98 @@
+// disktiming.h
+//	Data structures to model how long the simulated disk takes to
+//	serve a request.
+//
+//	The disk itself only moves bytes between the caller and its UNIX
+//	file; how much simulated time each request costs is up to a
+//	timing model, chosen when the disk is created:
+//
+//	  HDD -- a rotating disk, with seeks, rotational delay and a
+//		track buffer (see disk.h).  This is the original model.
+//	  SSD -- flash storage: no seeks, but every flash page a request
+//		touches costs a fixed time to read or to program.
+//	  Untimed -- every request finishes at once, for fast functional
+//		runs where only the results matter.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DISKTIMING_H
+#define DISKTIMING_H
+
+#include "copyright.h"
+#include "utility.h"
+
+// The timing models to choose from.
+
+enum DiskModel {
+    HDD,    // rotating disk
+    SSD,    // flash
+    Untimed // no delay at all
+};
+
+const int FlashPageSectors = 4; // sectors per SSD flash page
+
+// The following class defines the interface of a timing model.
+
+class DiskTiming
+{
+public:
+    virtual ~DiskTiming() {}
+
+    virtual int Latency(int newSector, bool writing, int numSectors) = 0;
+    // Return how long a request for
+    // numSectors sectors, starting at
+    // newSector, would take if it
+    // started now
+    virtual void Start(int newSector, bool writing, int numSectors) {}
+    // A request is starting now: update
+    // any state (such as the position of
+    // the head) that it changes
+
+    static DiskTiming *Create(DiskModel model); // Make a model
+    static bool ParseModel(char *name, DiskModel *model);
+    // Turn "hdd", "ssd" or "none"
+    //  into a model
+};
+
+// A rotating disk.
+
+class HDDTiming : public DiskTiming
+{
+public:
+    HDDTiming();
+
+    int Latency(int newSector, bool writing, int numSectors);
+    void Start(int newSector, bool writing, int numSectors);
+
+private:
+    int lastSector; // The previous disk request
+    int bufferInit; // When the track buffer started
+                    // being loaded
+
+    int TimeToSeek(int newSector, int *rotate); // time to get to the new track
+    int ModuloDiff(int to, int from);           // # sectors between to and from
+    void UpdateLast(int newSector);
+};
+
+// Flash storage.
+
+class SSDTiming : public DiskTiming
+{
+public:
+    int Latency(int newSector, bool writing, int numSectors);
+};
+
+// No delay.
+
+class UntimedTiming : public DiskTiming
+{
+public:
+    int Latency(int newSector, bool writing, int numSectors) { return 1; }
+    // the disk must still interrupt,
+    //  so one tick is the least it
+    //  can take
+};
+
+#endif // DISKTIMING_H
@@ -233,6 +233,15 @@ void Interrupt::Idle()
     // is not reached.  Instead, the halt must be invoked by the user program.
 
     DEBUG(dbgInt, "Machine idle.  No interrupts to do.");
+
+    // before stopping, let the kernel write back what it still holds in
+    // memory; it forks a thread to do so, and we come back here once
+    // that thread is done
+    if (kernel->SyncBeforeHalt())
+    {
+        status = SystemMode;
+        return;
+    }
     // MP4 mod tag
     /*
     cout << "No threads ready or runnable, and no pending interrupts.\n";
@@ -243,16 +252,18 @@ void Interrupt::Idle()
 
 //----------------------------------------------------------------------
 // Interrupt::Halt
-// 	Shut down Nachos cleanly, printing out performance statistics.
+// 	Shut down Nachos cleanly, printing out performance statistics
+//	if the "-ps" flag asked for them.
 //----------------------------------------------------------------------
 void Interrupt::Halt()
 {
-    // MP4 mod tag
-    /*
-    cout << "Machine halting!\n\n";
-    cout << "This is halt\n";
-    kernel->stats->Print();
-	*/
+    // MP4 mod tag: only print when asked to, so that the output of
+    // a run stays the program's own
+    if (kernel->PrintStatsOnHalt())
+    {
+        cout << "Machine halting!\n\n";
+        kernel->stats->Print();
+    }
     delete debug;
 
     delete kernel; // Never returns.
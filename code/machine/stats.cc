@@ -20,6 +20,18 @@ Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    numDiskRequests = numDiskMerges = 0;
+    totalDiskQueueDepth = maxDiskQueueDepth = 0;
+    totalDiskLatency = maxDiskLatency = 0;
+    numDisks = 1;
+    diskBusyTicks = volumeBusyTicks = 0;
+    numMirrorReads[0] = numMirrorReads[1] = numResyncSectors = 0;
+    numJournalCommits = numLogSectors = 0;
+    numCheckpoints = numReplayedGroups = 0;
+    numDentryHits = numDentryMisses = 0;
+    numCacheHits = numCacheMisses = 0;
+    numReadAheads = numReadAheadSectors = numReadAheadHits = 0;
+    maxReadAheadWindow = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
 }
@@ -37,6 +49,43 @@ Statistics::Print()
 		cout << ", system " << systemTicks << ", user " << userTicks <<"\n";
     cout << "Disk I/O: reads " << numDiskReads;
 		cout << ", writes " << numDiskWrites << "\n";
+    if (numDiskRequests > 0) {
+	cout << "Disk queue: requests " << numDiskRequests;
+		cout << ", merged " << numDiskMerges;
+		cout << ", depth avg " << totalDiskQueueDepth / numDiskRequests;
+		cout << " max " << maxDiskQueueDepth;
+		cout << ", latency avg " << totalDiskLatency / numDiskRequests;
+		cout << " max " << maxDiskLatency << "\n";
+    }
+    if (numDisks > 1 && volumeBusyTicks > 0) {
+	cout << "Disk array: disks " << numDisks;
+		cout << ", busy ticks " << volumeBusyTicks;
+		cout << ", sectors per 1000 busy ticks "
+		     << (numDiskReads + numDiskWrites) * 1000.0 / volumeBusyTicks;
+		cout << ", disks busy avg "
+		     << (double) diskBusyTicks / volumeBusyTicks << "\n";
+    }
+    if (numMirrorReads[0] + numMirrorReads[1] + numResyncSectors > 0) {
+	cout << "Mirror: reads a " << numMirrorReads[0];
+		cout << ", b " << numMirrorReads[1];
+		cout << ", resynced " << numResyncSectors << " sectors\n";
+    }
+    if (numJournalCommits + numReplayedGroups > 0) {
+	cout << "Journal: commits " << numJournalCommits;
+		cout << ", log sectors " << numLogSectors;
+		cout << ", checkpoints " << numCheckpoints;
+		cout << ", groups replayed " << numReplayedGroups << "\n";
+    }
+    if (numDentryHits + numDentryMisses > 0) {
+	cout << "Dentry cache: hits " << numDentryHits;
+		cout << ", misses " << numDentryMisses << "\n";
+    }
+    cout << "Block cache: hits " << numCacheHits;
+		cout << ", misses " << numCacheMisses << "\n";
+    cout << "Read-ahead: windows " << numReadAheads;
+		cout << ", sectors " << numReadAheadSectors;
+		cout << ", used " << numReadAheadHits;
+		cout << ", largest window " << maxReadAheadWindow << "\n";
 		cout << "Console I/O: reads " << numConsoleCharsRead;
     cout << ", writes " << numConsoleCharsWritten << "\n";
     cout << "Paging: faults " << numPageFaults << "\n";
@@ -30,6 +30,33 @@ class Statistics {
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int numDiskRequests;	// requests queued for the disk
+    int numDiskMerges;		// requests merged into a neighbour's
+    int totalDiskQueueDepth;	// sum over requests of the queue length
+				// each one found (itself included)
+    int maxDiskQueueDepth;	// longest the disk queue has been
+    int totalDiskLatency;	// sum over requests of the ticks from
+				// queueing to completion
+    int maxDiskLatency;		// slowest request, in ticks
+    int numDisks;		// disks the volume is spread across
+    int diskBusyTicks;		// sum over disks of the ticks each
+				// spent serving requests
+    int volumeBusyTicks;	// ticks during which at least one of
+				// several disks had work to do
+    int numMirrorReads[2];	// reads served by each mirror
+    int numResyncSectors;	// sectors copied to a stale mirror
+    int numJournalCommits;	// groups appended to the journal's log
+    int numLogSectors;		// log sectors they took up
+    int numCheckpoints;		// times the log was emptied
+    int numReplayedGroups;	// groups replayed when mounting
+    int numDentryHits;		// name lookups found in the dentry cache
+    int numDentryMisses;	// name lookups that read a directory
+    int numCacheHits;		// sector reads found in the block cache
+    int numCacheMisses;		// sector reads that had to go to disk
+    int numReadAheads;		// read-ahead windows started
+    int numReadAheadSectors;	// sectors read ahead into the cache
+    int numReadAheadHits;	// sectors read ahead, then asked for
+    int maxReadAheadWindow;	// largest read-ahead window, in sectors
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
@@ -53,6 +80,8 @@ const int UserTick = 	   1;	// advance for each user-level instruction
 const int SystemTick =	  10; 	// advance each time interrupts are enabled
 const int RotationTime = 500; 	// time disk takes to rotate one sector
 const int SeekTime =	 500;  	// time disk takes to seek past one track
+const int FlashReadTime =  50;	// time SSD takes to read one flash page
+const int FlashProgramTime = 200; // time SSD takes to program one flash page
 const int ConsoleTime =	 100;	// time to read or write one character
 const int NetworkTime =	 100;  	// time to send or receive one packet
 const int TimerTicks = 	 100;  	// (average) time between timer interrupts
@@ -15,8 +15,14 @@
 #include "libtest.h"
 #include "string.h"
 #include "synchdisk.h"
+#include "stripedvolume.h"
+#include "mirroredvolume.h"
 #include "post.h"
 #include "synchconsole.h"
+#ifndef FILESYS_STUB
+#include "inodecache.h"
+#include "dentrycache.h"
+#endif
 
 //----------------------------------------------------------------------
 // Kernel::Kernel
@@ -30,6 +36,17 @@ Kernel::Kernel(int argc, char **argv)
     debugUserProg = FALSE;
     consoleIn = NULL;  // default is stdin
     consoleOut = NULL; // default is stdout
+    blockCacheSize = DefaultBlockCacheSize;
+    writeBack = FALSE;
+    diskPolicy = FCFS;
+    mapDisk = FALSE;
+    diskModel = HDD;
+    numDisks = 1;
+    stripeUnit = DefaultStripeUnit;
+    mirrorDisks = FALSE;
+    offlineMirror = -1;
+    haltSynced = FALSE;
+    printStats = FALSE;
 #ifndef FILESYS_STUB
     formatFlag = FALSE;
 #endif
@@ -70,6 +87,65 @@ Kernel::Kernel(int argc, char **argv)
             ASSERT(i + 1 < argc);
             consoleOut = argv[i + 1];
             i++;
+        }
+        else if (strcmp(argv[i], "-bc") == 0)
+        {
+            ASSERT(i + 1 < argc); // next argument is int
+            blockCacheSize = atoi(argv[i + 1]);
+            ASSERT(blockCacheSize >= 0);
+            i++;
+        }
+        else if (strcmp(argv[i], "-wb") == 0)
+        {
+            writeBack = TRUE;
+        }
+        else if (strcmp(argv[i], "-ds") == 0)
+        {
+            ASSERT(i + 1 < argc); // next argument is a policy name
+            if (!DiskQueue::ParsePolicy(argv[i + 1], &diskPolicy))
+            {
+                cerr << "Unknown disk scheduling policy " << argv[i + 1] << "\n";
+                Abort();
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "-dm") == 0)
+        {
+            mapDisk = TRUE;
+        }
+        else if (strcmp(argv[i], "-dt") == 0)
+        {
+            ASSERT(i + 1 < argc); // next argument is a model name
+            if (!DiskTiming::ParseModel(argv[i + 1], &diskModel))
+            {
+                cerr << "Unknown disk timing model " << argv[i + 1] << "\n";
+                Abort();
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "-r0") == 0)
+        {
+            ASSERT(i + 2 < argc); // next arguments are ints
+            numDisks = atoi(argv[i + 1]);
+            stripeUnit = atoi(argv[i + 2]);
+            ASSERT(numDisks > 0 && stripeUnit > 0);
+            i += 2;
+        }
+        else if (strcmp(argv[i], "-r1") == 0)
+        {
+            mirrorDisks = TRUE;
+        }
+        else if (strcmp(argv[i], "-ps") == 0)
+        {
+            printStats = TRUE;
+        }
+        else if (strcmp(argv[i], "-r1off") == 0)
+        {
+            ASSERT(i + 1 < argc); // next argument is "a" or "b"
+            ASSERT(strcmp(argv[i + 1], "a") == 0 || strcmp(argv[i + 1], "b") == 0);
+            mirrorDisks = TRUE;
+            offlineMirror = argv[i + 1][0] - 'a';
+            i++;
 #ifndef FILESYS_STUB
         }
         else if (strcmp(argv[i], "-f") == 0)
@@ -94,6 +170,11 @@ Kernel::Kernel(int argc, char **argv)
             cout << "Partial usage: nachos [-rs randomSeed]\n";
             cout << "Partial usage: nachos [-s]\n";
             cout << "Partial usage: nachos [-ci consoleIn] [-co consoleOut]\n";
+            cout << "Partial usage: nachos [-bc cacheSectors] [-wb]\n";
+            cout << "Partial usage: nachos [-ds fcfs|sstf|scan|clook] [-dm]\n";
+            cout << "Partial usage: nachos [-dt hdd|ssd|none] [-r0 disks stripeSectors]\n";
+            cout << "Partial usage: nachos [-r1] [-r1off a|b]\n";
+            cout << "Partial usage: nachos [-ps]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-nf]\n";
 #endif
@@ -111,6 +192,9 @@ Kernel::Kernel(int argc, char **argv)
 
 void Kernel::Initialize()
 {
+    BlockDevice *diskDevice; // what the synch disk reaches the disk(s) by
+    MirroredVolume *mirror;
+
     // We didn't explicitly allocate the current thread we are running in.
     // But if it ever tries to give up the CPU, we better have a Thread
     // object to save its state.
@@ -125,10 +209,22 @@ void Kernel::Initialize()
     machine = new Machine(debugUserProg);
     synchConsoleIn = new SynchConsoleInput(consoleIn);    // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
-    synchDisk = new SynchDisk();                          //
+    if (mirrorDisks)
+    {
+        mirror = new MirroredVolume(diskPolicy, mapDisk, diskModel, offlineMirror);
+        mirror->Resync(); // before the file system reads anything
+        diskDevice = mirror;
+    }
+    else if (numDisks > 1)
+        diskDevice = new StripedVolume(numDisks, stripeUnit, diskPolicy, mapDisk, diskModel);
+    else
+        diskDevice = new DiskQueue(diskPolicy, mapDisk, diskModel);
+    synchDisk = new SynchDisk(diskDevice, blockCacheSize, writeBack);
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
+    inodeCache = new InodeCache(InodeCacheSize);
+    dentryCache = new DentryCache(DentryCacheSize);
     fileSystem = new FileSystem(formatFlag);
 #endif // FILESYS_STUB
 
@@ -154,13 +250,55 @@ void Kernel::PrepareToEnd()
     synchConsoleIn->Disable();
 }
 
+//----------------------------------------------------------------------
+// HaltSync
+// 	Body of the thread forked by SyncBeforeHalt.
+//----------------------------------------------------------------------
+
+static void
+HaltSync(void *unused)
+{
+    kernel->Sync();
+}
+
+//----------------------------------------------------------------------
+// Kernel::SyncBeforeHalt
+// 	Called by Interrupt::Idle when nothing is left to run, and Nachos
+//	is about to halt.  Whatever the file system still holds in memory,
+//	and any sectors the block cache is holding back in write-back
+//	mode, have to be written back first, while the disk can still be waited
+//	for: once Halt starts tearing things down, it cannot.  Writing it
+//	back means waiting, which the idle loop cannot do, so the first
+//	time, fork a thread to do it, and return TRUE.  After that, return
+//	FALSE; it is time to halt.
+//----------------------------------------------------------------------
+
+bool Kernel::SyncBeforeHalt()
+{
+    Thread *thread;
+
+    if (haltSynced)
+        return FALSE;
+    haltSynced = TRUE;
+    thread = new Thread("halt sync", -1);
+    thread->Fork((VoidFunctionPtr)HaltSync, NULL);
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // Kernel::~Kernel
-// 	Nachos is halting.  De-allocate global data structures.
+// 	Nachos is halting.  De-allocate global data structures.  Everything
+//	has been written back by now (see SyncBeforeHalt, and SysHalt), so
+//	this only frees memory; the disk is not used again.
 //----------------------------------------------------------------------
 
 Kernel::~Kernel()
 {
+    delete fileSystem; // closes its files, so goes before the disk
+#ifndef FILESYS_STUB
+    delete inodeCache;
+    delete dentryCache;
+#endif
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -169,7 +307,6 @@ Kernel::~Kernel()
     delete synchConsoleIn;
     delete synchConsoleOut;
     delete synchDisk;
-    delete fileSystem;
 
     // Mp4 mod tag
     /*
@@ -355,4 +492,19 @@ int Kernel::CreateFile(char *filename)
 int Kernel::CreateFile(char *filename, int size)
 {
     return fileSystem->Create(filename, size);
+}
+
+//----------------------------------------------------------------------
+// Kernel::Sync
+// 	Write everything the file system is holding in memory, including
+//	sectors waiting in the block cache, out to disk.  Return only once
+//	it is all there.
+//----------------------------------------------------------------------
+
+void Kernel::Sync()
+{
+#ifndef FILESYS_STUB
+    fileSystem->Sync();
+#endif
+    synchDisk->Sync();
 }
\ No newline at end of file
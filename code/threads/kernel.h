@@ -15,6 +15,7 @@
 #include "scheduler.h"
 #include "interrupt.h"
 #include "stats.h"
+#include "diskqueue.h"
 #include "alarm.h"
 #include "filesys.h"
 #include "machine.h"
@@ -24,6 +25,8 @@ class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class InodeCache;
+class DentryCache;
 
 class Kernel
 {
@@ -38,6 +41,10 @@ public:
 
     // 2015.11.25 added
     void PrepareToEnd(); // called before all running programs end
+    bool SyncBeforeHalt(); // called when nothing is left to run;
+                           // TRUE if there is writing back to do first
+    bool PrintStatsOnHalt() { return printStats; }
+                           // TRUE if "-ps" asked for statistics
 
     void ExecAll();
     int Exec(char *name);
@@ -52,6 +59,9 @@ public:
 #endif
 
     int CreateFile(char *filename, int size); // =================================this is my code=================================================
+
+    void Sync(); // write everything the file system holds
+                 // in memory out to disk
     // These are public for notational convenience; really,
     // they're global variables used everywhere.
 
@@ -64,6 +74,10 @@ public:
     SynchConsoleInput *synchConsoleIn;
     SynchConsoleOutput *synchConsoleOut;
     SynchDisk *synchDisk;
+#ifndef FILESYS_STUB
+    InodeCache *inodeCache;   // file headers shared by open files
+    DentryCache *dentryCache; // names recently looked up
+#endif
     FileSystem *fileSystem;
     PostOfficeInput *postOfficeIn;
     PostOfficeOutput *postOfficeOut;
@@ -80,6 +94,17 @@ private:
     double reliability; // likelihood messages are dropped
     char *consoleIn;    // file to read console input from
     char *consoleOut;   // file to send console output to
+    int blockCacheSize; // sectors kept in the disk block cache
+    bool writeBack;     // hold disk writes in the block cache
+    DiskPolicy diskPolicy; // order in which disk requests are served
+    bool mapDisk;       // map the disk's UNIX file into memory
+    DiskModel diskModel; // how long disk requests take
+    int numDisks;       // disks to stripe the volume across
+    int stripeUnit;     // sectors per stripe unit
+    bool mirrorDisks;   // mirror the volume across two disks
+    int offlineMirror;  // mirror to leave out, or -1
+    bool haltSynced;    // has SyncBeforeHalt's thread been forked?
+    bool printStats;    // print performance statistics on halt
 #ifndef FILESYS_STUB
     bool formatFlag; // format the disk if this is true
 #endif
@@ -76,6 +76,8 @@ AddrSpace::AddrSpace()
 	pageTable[i].dirty = FALSE;
 	pageTable[i].readOnly = FALSE;  
     }
+    for (int i = 0; i < MaxOpenFiles; i++)
+	openFiles[i] = NULL;
     
     // zero out the entire address space
     bzero(kernel->machine->mainMemory, MemorySize);
@@ -83,14 +85,74 @@ AddrSpace::AddrSpace()
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.
+// 	Dealloate an address space, closing any files the program left
+//	open.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+   for (int i = 0; i < MaxOpenFiles; i++)
+	delete openFiles[i];
    delete pageTable;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Enter a file the program has opened in its table of open files,
+//	and return the id the program names it by.  The id is an index
+//	into the table, not the OpenFile's address, so that it fits the
+//	program's registers whatever the size of a pointer.  Return 0 if
+//	"file" is NULL, or the table is full; the file is then closed.
+//
+//	"file" -- the file, as opened by the file system
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddFile(OpenFile *file)
+{
+    if (file == NULL)
+	return 0;
+    for (int i = 0; i < MaxOpenFiles; i++)
+	if (openFiles[i] == NULL) {
+	    openFiles[i] = file;
+	    return i + FirstFileId;
+	}
+    delete file;			// too many files open
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::GetFile
+// 	Return the open file the program names by "id", or NULL if "id"
+//	names none.
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::GetFile(int id)
+{
+    if (id < FirstFileId || id >= FirstFileId + MaxOpenFiles)
+	return NULL;
+    return openFiles[id - FirstFileId];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::RemoveFile
+// 	Close the open file "id", and free its id.  Return FALSE if "id"
+//	names no open file.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::RemoveFile(int id)
+{
+    OpenFile *file = GetFile(id);
+
+    if (file == NULL)
+	return FALSE;
+    delete file;
+    openFiles[id - FirstFileId] = NULL;
+    return TRUE;
+}
+
 
 //----------------------------------------------------------------------
 // AddrSpace::Load
@@ -17,6 +17,8 @@
 #include "filesys.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		16	// files a program may have open
+#define FirstFileId		2	// ids below are the console's
 
 class AddrSpace {
   public:
@@ -39,11 +41,19 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    int AddFile(OpenFile *file);	// Give an open file an id (an
+					// OpenFileId) for the program to
+					// use; 0 if it has too many open
+    OpenFile *GetFile(int id);		// The open file "id" names, or NULL
+    bool RemoveFile(int id);		// Close "id"; FALSE if it is not open
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    OpenFile *openFiles[MaxOpenFiles];	// Files the program has open; the
+					// one with id i is at i - FirstFileId
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
@@ -138,6 +138,67 @@ void ExceptionHandler(ExceptionType which)
             break;
 
         // =================================above is my code=================================================
+        case SC_Sync:
+            DEBUG(dbgSys, "Sync, initiated by user program.\n");
+            SysSync();
+            kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+            kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            return;
+            ASSERTNOTREACHED();
+            break;
+        case SC_OpenDir:
+            val = kernel->machine->ReadRegister(4);
+            {
+                char *name = &(kernel->machine->mainMemory[val]);
+                kernel->machine->WriteRegister(2, SysOpenDir(name));
+            }
+            kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+            kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            return;
+            ASSERTNOTREACHED();
+            break;
+        case SC_CreateAt:
+            val = kernel->machine->ReadRegister(5);
+            {
+                OpenFileId dir = kernel->machine->ReadRegister(4);
+                char *name = &(kernel->machine->mainMemory[val]);
+                int size = kernel->machine->ReadRegister(6);
+                kernel->machine->WriteRegister(2, SysCreateAt(dir, name, size));
+            }
+            kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+            kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            return;
+            ASSERTNOTREACHED();
+            break;
+        case SC_OpenAt:
+            val = kernel->machine->ReadRegister(5);
+            {
+                OpenFileId dir = kernel->machine->ReadRegister(4);
+                char *name = &(kernel->machine->mainMemory[val]);
+                kernel->machine->WriteRegister(2, SysOpenAt(dir, name));
+            }
+            kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+            kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            return;
+            ASSERTNOTREACHED();
+            break;
+        case SC_RemoveAt:
+            val = kernel->machine->ReadRegister(5);
+            {
+                OpenFileId dir = kernel->machine->ReadRegister(4);
+                char *name = &(kernel->machine->mainMemory[val]);
+                kernel->machine->WriteRegister(2, SysRemoveAt(dir, name));
+            }
+            kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+            kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+            return;
+            ASSERTNOTREACHED();
+            break;
         case SC_Halt:
             DEBUG(dbgSys, "Shutdown, initiated by user program.\n");
             SysHalt();
@@ -15,39 +15,41 @@
 
 #include "synchconsole.h"
 
+// Open files are named by ids into the running program's table of
+// them (see AddrSpace::AddFile), never by their addresses.
+
+AddrSpace *SysFiles()
+{
+    return kernel->currentThread->space;
+}
+
 // =================================below is my code=================================================
 
 int SysRead(char *buffer, int size, OpenFileId id)
 {
     // std::cout << "Read????" << std::endl;
-    OpenFile *file = (OpenFile *)id;
+    OpenFile *file = SysFiles()->GetFile(id);
+    if (file == NULL)
+        return -1;
     return file->Read(buffer, size);
 }
 
 int SysClose(OpenFileId id)
 {
-    OpenFile *file = (OpenFile *)id;
-    try
-    {
-        file->~OpenFile();
-    }
-    catch (std::string e)
-    {
-        throw e;
-        return 0;
-    }
-    return 1;
+    return SysFiles()->RemoveFile(id) ? 1 : -1;
 }
 
 int SysWrite(char *buffer, int size, OpenFileId id)
 {
-    OpenFile *file = (OpenFile *)id;
+    OpenFile *file = SysFiles()->GetFile(id);
+    if (file == NULL)
+        return -1;
     return file->Write(buffer, size);
 }
 
 OpenFileId SysOpen(char *name)
 {
-    return (int)(kernel->fileSystem->Open(name));
+    return SysFiles()->AddFile(kernel->fileSystem->Open(name));
 }
 
 int SysCreate(char *filename, int size)
@@ -60,8 +62,34 @@ int SysCreate(char *filename, int size)
 
 // =================================above is my code=================================================
 
+OpenFileId SysOpenDir(char *name)
+{
+    return SysFiles()->AddFile(kernel->fileSystem->OpenDir(name));
+}
+
+int SysCreateAt(OpenFileId dir, char *name, int size)
+{
+    return kernel->fileSystem->CreateAt(SysFiles()->GetFile(dir), name, size);
+}
+
+OpenFileId SysOpenAt(OpenFileId dir, char *name)
+{
+    return SysFiles()->AddFile(kernel->fileSystem->OpenAt(SysFiles()->GetFile(dir), name));
+}
+
+int SysRemoveAt(OpenFileId dir, char *name)
+{
+    return kernel->fileSystem->RemoveAt(SysFiles()->GetFile(dir), name);
+}
+
+void SysSync()
+{
+    kernel->Sync();
+}
+
 void SysHalt()
 {
+    kernel->Sync(); // nothing can be written once we are halting
     kernel->interrupt->Halt();
 }
 
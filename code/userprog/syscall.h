@@ -34,6 +34,11 @@
 #define SC_ExecV 13
 #define SC_ThreadExit 14
 #define SC_ThreadJoin 15
+#define SC_Sync 16
+#define SC_OpenDir 17
+#define SC_CreateAt 18
+#define SC_OpenAt 19
+#define SC_RemoveAt 20
 #define SC_Add 42
 #define SC_MSG 100
 
@@ -149,6 +154,28 @@ int Seek(int position, OpenFileId id);
  */
 int Close(OpenFileId id);
 
+/* Write everything the file system is holding in memory out to disk.
+ * Return once it is all there.
+ */
+void Sync();
+
+/* Open the directory "name", and return an "OpenFileId" for it, to be
+ * passed to CreateAt, OpenAt and RemoveAt, and closed with Close.
+ * Return 0 if there is no such directory.
+ */
+OpenFileId OpenDir(char *name);
+
+/* Create, open and remove the file "name" in the open directory "dir",
+ * like Create, Open and Remove; "name" is a single name, not a path.
+ * The directory's path is not walked again, so these cost the same
+ * however deep the directory is.
+ */
+int CreateAt(OpenFileId dir, char *name, int size);
+
+OpenFileId OpenAt(OpenFileId dir, char *name);
+
+int RemoveAt(OpenFileId dir, char *name);
+
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
  *